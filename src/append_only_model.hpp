@@ -0,0 +1,297 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_APPEND_ONLY_MODEL_HPP
+#define IMV_APPEND_ONLY_MODEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <QTimer>
+#include <QVector>
+#include "model.hpp"
+
+namespace imv {
+
+/**
+ * \brief Flat model for streams where rows are only appended, like log files
+ *
+ * Rows are stored in blocks of fixed size, once a row has been appended it
+ * never changes. A single producer thread can call append() without
+ * locking: rows are published to the model thread, which shows them with
+ * at most one rowsAdded() per frame.
+ *
+ * With a maximum row count, the oldest blocks are dropped with one
+ * rowsRemoved() each, so the model keeps between maximumRows() minus a
+ * block and maximumRows() rows.
+ */
+class AppendOnlyModel : public Model
+{
+    Q_OBJECT
+
+public:
+    typedef QVector<QVariant> Row;
+
+    /**
+     * \param column_count  Number of columns of each row
+     * \param block_size    Number of rows in a block
+     */
+    explicit AppendOnlyModel(int column_count, int block_size = 4096)
+        : column_count_(std::max(column_count, 0)),
+          block_size_(std::max(block_size, 1))
+    {
+        blocks_.push_back(new Block(block_size_));
+        tail_ = blocks_.back();
+
+        frame_timer_.setSingleShot(true);
+        frame_timer_.setInterval(16);
+        connect(&frame_timer_, &QTimer::timeout, this, &AppendOnlyModel::publish);
+    }
+
+    /**
+     * \note The producer thread must have stopped appending
+     */
+    ~AppendOnlyModel()
+    {
+        Block* block = blocks_.front();
+        while ( block )
+        {
+            Block* next = block->next.load(std::memory_order_acquire);
+            delete block;
+            block = next;
+        }
+    }
+
+    /**
+     * \brief Appends a row, can be called from a thread other than the model's
+     *
+     * Only one thread at a time can append rows. Values past columnCount()
+     * are ignored.
+     */
+    void append(const Row& row)
+    {
+        int count = tail_->count.load(std::memory_order_relaxed);
+        if ( count == block_size_ )
+        {
+            Block* block = new Block(block_size_);
+            tail_->next.store(block, std::memory_order_release);
+            tail_ = block;
+            count = 0;
+        }
+        tail_->rows[count] = row;
+        tail_->count.store(count + 1, std::memory_order_release);
+
+        if ( !notify_pending_.exchange(true, std::memory_order_acq_rel) )
+            QMetaObject::invokeMethod(this, [this]{ onRowsAppended(); }, Qt::QueuedConnection);
+    }
+
+    /**
+     * \brief Appends several rows, see append(const Row&)
+     */
+    void append(const QVector<Row>& rows)
+    {
+        for ( const Row& row : rows )
+            append(row);
+    }
+
+    /**
+     * \brief Shows the rows appended so far right away, instead of waiting for the next frame
+     */
+    void publish()
+    {
+        frame_timer_.stop();
+        notify_pending_.store(false, std::memory_order_release);
+
+        while ( Block* next = blocks_.back()->next.load(std::memory_order_acquire) )
+            blocks_.push_back(next);
+        int rows = (blocks_.size() - 1) * block_size_ +
+                   blocks_.back()->count.load(std::memory_order_acquire);
+
+        if ( rows > rows_ )
+        {
+            int old_rows = rows_;
+            rows_ = rows;
+            notifyRowsAdded(old_rows, rows - old_rows, Index());
+        }
+
+        // The first block is full and not the last, so the producer is done with it
+        while ( max_rows_ > 0 && rows_ > max_rows_ && blocks_.size() > 1 )
+        {
+            delete blocks_.front();
+            blocks_.pop_front();
+            rows_ -= block_size_;
+            evicted_ += block_size_;
+            notifyRowsRemoved(0, block_size_, Index());
+        }
+
+        if ( follow_tail_ && rows_ > 0 )
+            emit tailChanged(rows_ - 1);
+    }
+
+    /**
+     * \brief Keeps at most \p rows rows, dropping the oldest blocks, 0 for no limit
+     *
+     * The limit can't be less than a block.
+     */
+    void setMaximumRows(int rows)
+    {
+        max_rows_ = std::max(rows, 0);
+        publish();
+    }
+
+    int maximumRows() const
+    {
+        return max_rows_;
+    }
+
+    /**
+     * \brief Whether views should keep showing the last row
+     *
+     * When enabled, tailChanged() is emitted whenever rows are shown.
+     * Views should disable it when the user scrolls away from the end.
+     */
+    void setFollowTail(bool follow)
+    {
+        follow_tail_ = follow;
+        if ( follow_tail_ && rows_ > 0 )
+            emit tailChanged(rows_ - 1);
+    }
+
+    bool followTail() const
+    {
+        return follow_tail_;
+    }
+
+    /**
+     * \brief Minimum time in milliseconds between two rowsAdded()
+     */
+    void setFrameInterval(int msec)
+    {
+        frame_timer_.setInterval(std::max(msec, 0));
+    }
+
+    int blockSize() const
+    {
+        return block_size_;
+    }
+
+    /**
+     * \brief Number of rows dropped because of maximumRows()
+     *
+     * Row 0 is the row appended after evictedRows() others.
+     */
+    qint64 evictedRows() const
+    {
+        return evicted_;
+    }
+
+signals:
+    /**
+     * \brief Emitted when following the tail and \p row has become the last one
+     */
+    void tailChanged(int row);
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : rows_;
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : column_count_;
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < rows_ && index.column() < column_count_;
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return QVariant();
+        return row(index.row()).value(index.column());
+    }
+
+    QVector<QVariant> onDataRange(int column, int row, int count,
+                                  const Index& parent, int role) const override
+    {
+        QVector<QVariant> values;
+        values.reserve(count);
+        for ( int i = row; i < row + count; )
+        {
+            const Block* block = blocks_[i / block_size_];
+            int offset = i % block_size_;
+            int end = std::min(block_size_, offset + row + count - i);
+            for ( int j = offset; j < end; j++ )
+                values.append(role == Value ? block->rows[j].value(column) : QVariant());
+            i += end - offset;
+        }
+        return values;
+    }
+
+private:
+    struct Block
+    {
+        explicit Block(int size)
+            : rows(size)
+        {}
+
+        std::vector<Row> rows;
+        /// Rows published by the producer
+        std::atomic<int> count{0};
+        /// Set by the producer once the block is full
+        std::atomic<Block*> next{nullptr};
+    };
+
+    const Row& row(int row) const
+    {
+        return blocks_[row / block_size_]->rows[row % block_size_];
+    }
+
+    /**
+     * \brief Called in the model thread after rows have been appended
+     */
+    void onRowsAppended()
+    {
+        if ( !frame_timer_.isActive() )
+            frame_timer_.start();
+    }
+
+    int column_count_;
+    int block_size_;
+
+    /// Blocks seen by the model thread, all full but the last one
+    std::deque<Block*> blocks_;
+    int rows_ = 0;
+    qint64 evicted_ = 0;
+    int max_rows_ = 0;
+    bool follow_tail_ = false;
+    QTimer frame_timer_;
+
+    /// Last block, only used by the producer
+    Block* tail_;
+    std::atomic<bool> notify_pending_{false};
+};
+
+} // namespace imv
+#endif // IMV_APPEND_ONLY_MODEL_HPP
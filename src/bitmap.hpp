@@ -0,0 +1,291 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_BITMAP_HPP
+#define IMV_BITMAP_HPP
+
+#include <algorithm>
+#include <vector>
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+namespace imv {
+
+/**
+ * \brief Packed sequence of bits supporting insertion and removal
+ */
+class Bitmap
+{
+public:
+    enum { word_bits = 64 };
+
+    Bitmap() = default;
+
+    explicit Bitmap(int size, bool value = false)
+    {
+        resize(size, value);
+    }
+
+    /**
+     * \brief Number of bits
+     */
+    int size() const
+    {
+        return size_;
+    }
+
+    /**
+     * \brief Value of the given bit
+     */
+    bool test(int bit) const
+    {
+        return (words_[bit / word_bits] >> (bit % word_bits)) & 1;
+    }
+
+    bool operator[](int bit) const
+    {
+        return test(bit);
+    }
+
+    /**
+     * \brief Sets the value of the given bit
+     */
+    void set(int bit, bool value = true)
+    {
+        quint64 mask = quint64(1) << (bit % word_bits);
+        if ( value )
+            words_[bit / word_bits] |= mask;
+        else
+            words_[bit / word_bits] &= ~mask;
+    }
+
+    /**
+     * \brief Sets \p count bits starting from \p bit to \p value
+     */
+    void fill(int bit, int count, bool value)
+    {
+        for ( ; count > 0 && bit % word_bits; bit++, count-- )
+            set(bit, value);
+        for ( ; count >= word_bits; bit += word_bits, count -= word_bits )
+            words_[bit / word_bits] = value ? ~quint64(0) : 0;
+        for ( ; count > 0; bit++, count-- )
+            set(bit, value);
+    }
+
+    /**
+     * \brief Number of bits set to 1
+     */
+    int count() const
+    {
+        int total = 0;
+        for ( quint64 word : words_ )
+            total += qPopulationCount(word);
+        return total;
+    }
+
+    /**
+     * \brief Index of the first bit set at or after \p bit
+     * \returns size() if there are no more bits set
+     */
+    int nextSet(int bit) const
+    {
+        if ( bit >= size_ )
+            return size_;
+        int index = bit / word_bits;
+        quint64 word = words_[index] & (~quint64(0) << (bit % word_bits));
+        while ( !word )
+        {
+            if ( ++index >= int(words_.size()) )
+                return size_;
+            word = words_[index];
+        }
+        return std::min<int>(index * word_bits + qCountTrailingZeroBits(word), size_);
+    }
+
+    /**
+     * \brief Changes the number of bits, new bits are set to \p value
+     */
+    void resize(int size, bool value = false)
+    {
+        int old_size = size_;
+        size_ = size;
+        words_.resize((size + word_bits - 1) / word_bits, 0);
+        if ( size > old_size )
+            fill(old_size, size - old_size, value);
+        clearPadding();
+    }
+
+    /**
+     * \brief Inserts \p count bits with the given value before \p bit
+     */
+    void insert(int bit, int count, bool value)
+    {
+        int old_size = size_;
+        resize(size_ + count);
+        for ( int end = old_size; end > bit; )
+        {
+            int chunk = std::min<int>(word_bits, end - bit);
+            end -= chunk;
+            write(end + count, chunk, read(end, chunk));
+        }
+        fill(bit, count, value);
+    }
+
+    /**
+     * \brief Removes \p count bits starting from \p bit
+     */
+    void remove(int bit, int count)
+    {
+        for ( int from = bit + count; from < size_; from += word_bits )
+        {
+            int chunk = std::min<int>(word_bits, size_ - from);
+            write(from - count, chunk, read(from, chunk));
+        }
+        resize(size_ - count);
+    }
+
+    /**
+     * \brief Moves \p count bits starting from \p bit before \p to_bit
+     */
+    void move(int bit, int count, int to_bit)
+    {
+        Bitmap moved = slice(bit, count);
+        remove(bit, count);
+        if ( to_bit > bit )
+            to_bit -= count;
+        insert(to_bit, count, false);
+        for ( int i = 0; i < count; i += word_bits )
+        {
+            int chunk = std::min<int>(word_bits, count - i);
+            write(to_bit + i, chunk, moved.read(i, chunk));
+        }
+    }
+
+    /**
+     * \brief Copy of \p count bits starting from \p bit
+     */
+    Bitmap slice(int bit, int count) const
+    {
+        Bitmap result(count);
+        for ( int i = 0; i < count; i += word_bits )
+        {
+            int chunk = std::min<int>(word_bits, count - i);
+            result.write(i, chunk, read(bit + i, chunk));
+        }
+        return result;
+    }
+
+    /**
+     * \brief Reads up to 64 bits starting from \p bit
+     */
+    quint64 read(int bit, int count) const
+    {
+        int index = bit / word_bits;
+        int shift = bit % word_bits;
+        quint64 value = words_[index] >> shift;
+        if ( shift && shift + count > word_bits )
+            value |= words_[index + 1] << (word_bits - shift);
+        return value & mask(count);
+    }
+
+    /**
+     * \brief Writes the lowest \p count bits of \p value starting from \p bit
+     */
+    void write(int bit, int count, quint64 value)
+    {
+        int index = bit / word_bits;
+        int shift = bit % word_bits;
+        value &= mask(count);
+        words_[index] = (words_[index] & ~(mask(count) << shift)) | (value << shift);
+        if ( shift && shift + count > word_bits )
+        {
+            int high = shift + count - word_bits;
+            words_[index + 1] = (words_[index + 1] & ~mask(high)) |
+                                (value >> (word_bits - shift));
+        }
+    }
+
+    /**
+     * \brief Underlying words, bit \c i is in word <tt>i / 64</tt>
+     *
+     * Bits past size() are always 0.
+     */
+    const std::vector<quint64>& words() const
+    {
+        return words_;
+    }
+
+    quint64* data()
+    {
+        return words_.data();
+    }
+
+    Bitmap& operator&=(const Bitmap& other)
+    {
+        for ( std::size_t i = 0; i < words_.size(); i++ )
+            words_[i] &= other.words_[i];
+        return *this;
+    }
+
+    Bitmap& operator|=(const Bitmap& other)
+    {
+        for ( std::size_t i = 0; i < words_.size(); i++ )
+            words_[i] |= other.words_[i];
+        return *this;
+    }
+
+    /**
+     * \brief Inverts all the bits
+     */
+    void flip()
+    {
+        for ( quint64& word : words_ )
+            word = ~word;
+        clearPadding();
+    }
+
+    bool operator==(const Bitmap& other) const
+    {
+        return size_ == other.size_ && words_ == other.words_;
+    }
+
+    bool operator!=(const Bitmap& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    static quint64 mask(int count)
+    {
+        return count >= word_bits ? ~quint64(0) : (quint64(1) << count) - 1;
+    }
+
+    void clearPadding()
+    {
+        if ( size_ % word_bits )
+            words_.back() &= mask(size_ % word_bits);
+    }
+
+    std::vector<quint64> words_;
+    int size_ = 0;
+};
+
+} // namespace imv
+#endif // IMV_BITMAP_HPP
@@ -0,0 +1,514 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_CACHING_PROXY_MODEL_HPP
+#define IMV_CACHING_PROXY_MODEL_HPP
+
+#include <algorithm>
+#include <list>
+#include <QHash>
+#include "model.hpp"
+#include "column.hpp"
+
+namespace imv {
+
+/**
+ * \brief Caches the top-level items of a model with expensive data()
+ *
+ * Values are kept in an LRU cache keyed by row, column and role, bounded
+ * by an approximate memory budget. Cache misses fetch a whole page of rows
+ * through Model::dataRange(), following the direction rows are being
+ * accessed in, and the next page is prefetched before it's reached.
+ *
+ * dataChanged() from the source drops only the changed entry, structural
+ * changes and layout changes with a permutation shift the cached keys.
+ */
+class CachingProxyModel : public Model
+{
+public:
+    /**
+     * \param source      Model to cache
+     * \param budget      Approximate number of bytes used by the cache
+     * \param page_size   Number of rows fetched at once
+     */
+    explicit CachingProxyModel(Model* source = nullptr,
+                               std::size_t budget = 16 * 1024 * 1024,
+                               int page_size = 256)
+        : budget_(budget),
+          page_size_(std::max(page_size, 1))
+    {
+        setSourceModel(source);
+    }
+
+    Model* sourceModel() const
+    {
+        return source_;
+    }
+
+    /**
+     * \brief Sets the model to cache, clearing the cache
+     */
+    void setSourceModel(Model* source)
+    {
+        if ( source_ )
+            QObject::disconnect(source_, nullptr, this, nullptr);
+
+        clear();
+        source_ = source;
+        if ( source_ )
+        {
+            connect(source_, &Model::dataChanged, this, &CachingProxyModel::onSourceDataChanged);
+            connect(source_, &Model::dataRangeChanged, this, &CachingProxyModel::onSourceDataRangeChanged);
+            connect(source_, &Model::rowsAdded, this, &CachingProxyModel::onSourceRowsAdded);
+            connect(source_, &Model::rowsRemoved, this, &CachingProxyModel::onSourceRowsRemoved);
+            connect(source_, &Model::rowsShifted, this, &CachingProxyModel::onSourceRowsShifted);
+            connect(source_, &Model::rowsMoved, this, &CachingProxyModel::onSourceRowsMoved);
+            connect(source_, &Model::columnsAdded, this, &CachingProxyModel::onSourceColumnsAdded);
+            connect(source_, &Model::columnsRemoved, this, &CachingProxyModel::onSourceColumnsRemoved);
+            connect(source_, &Model::columnsMoved, this, &CachingProxyModel::onSourceColumnsMoved);
+            connect(source_, &Model::modelAboutToReset, this, &CachingProxyModel::beginReset);
+            connect(source_, &Model::modelReset, this, &CachingProxyModel::onSourceModelReset);
+            connect(source_, &Model::layoutAboutToChange, this, &CachingProxyModel::onSourceLayoutAboutToChange);
+            connect(source_, &Model::layoutChanged, this, &CachingProxyModel::onSourceLayoutChanged);
+        }
+    }
+
+    /**
+     * \brief Sets the approximate number of bytes used by the cache
+     */
+    void setBudget(std::size_t budget)
+    {
+        budget_ = budget;
+        evict();
+    }
+
+    std::size_t budget() const
+    {
+        return budget_;
+    }
+
+    /**
+     * \brief Approximate number of bytes currently used by the cache
+     */
+    std::size_t cacheCost() const
+    {
+        return cost_;
+    }
+
+    /**
+     * \brief Number of cached values
+     */
+    int cacheSize() const
+    {
+        return entries_.size();
+    }
+
+    /**
+     * \brief Number of data() calls served from the cache
+     */
+    qint64 hits() const
+    {
+        return hits_;
+    }
+
+    /**
+     * \brief Number of data() calls which required fetching from the source
+     */
+    qint64 misses() const
+    {
+        return misses_;
+    }
+
+    /**
+     * \brief Drops all the cached values
+     */
+    void clear()
+    {
+        entries_.clear();
+        lru_.clear();
+        cost_ = 0;
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() || !source_ ? 0 : source_->rowCount();
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() || !source_ ? 0 : source_->columnCount();
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < rowCount() && index.column() < columnCount();
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        int row = index.row();
+        if ( row != last_row_ )
+        {
+            direction_ = row > last_row_ ? 1 : -1;
+            last_row_ = row;
+        }
+
+        Key key{row, index.column(), role};
+        auto iter = entries_.find(key);
+        if ( iter != entries_.end() )
+        {
+            hits_++;
+            lru_.splice(lru_.begin(), lru_, iter->lru);
+            QVariant value = iter->value;
+
+            // Fetch the next page while the current one is still being read
+            int ahead = row + direction_ * page_size_ / 2;
+            if ( ahead >= 0 && ahead < rowCount() &&
+                 !entries_.contains(Key{ahead, key.column, role}) )
+            {
+                // Stops at ahead at the latest
+                int next = row + direction_;
+                while ( entries_.contains(Key{next, key.column, role}) )
+                    next += direction_;
+                fetchMissing(next, key.column, role);
+            }
+            return value;
+        }
+
+        misses_++;
+        fetchPage(row, key.column, role);
+        iter = entries_.find(key);
+        return iter != entries_.end() ? iter->value : source_->data(source_->index(row, key.column), role);
+    }
+
+    QVector<QVariant> onDataRange(int column, int row, int count,
+                                  const Index& parent, int role) const override
+    {
+        return source_->dataRange(column, row, count, Index(), role);
+    }
+
+    bool onSetData(const Index& index, const QVariant& value, int role) override
+    {
+        return source_->setData(source_->index(index.row(), index.column()), value, role);
+    }
+
+private:
+    struct Key
+    {
+        int row;
+        int column;
+        int role;
+
+        bool operator==(const Key& other) const
+        {
+            return row == other.row && column == other.column && role == other.role;
+        }
+
+        friend uint qHash(const Key& key, uint seed = 0)
+        {
+            return qHash(quint64(key.row) << 32 | uint(key.column), seed) ^ uint(key.role);
+        }
+    };
+
+    struct Entry
+    {
+        QVariant value;
+        std::size_t cost;
+        std::list<Key>::iterator lru;
+    };
+
+    /**
+     * \brief Approximate memory used to cache \p value
+     */
+    static std::size_t valueCost(const QVariant& value)
+    {
+        std::size_t cost = sizeof(Key) + sizeof(Entry) + 4 * sizeof(void*);
+        if ( value.userType() == QMetaType::QString )
+            cost += value.toString().size() * sizeof(QChar);
+        else if ( value.userType() == QMetaType::QByteArray )
+            cost += value.toByteArray().size();
+        return cost;
+    }
+
+    /**
+     * \brief Fetches a page of rows starting from \p row in the current direction
+     */
+    void fetchPage(int row, int column, int role) const
+    {
+        int rows = rowCount();
+        int first = direction_ < 0 ? row - page_size_ + 1 : row;
+        // Keep the page full near the edges of the model
+        first = std::max(0, std::min(first, rows - page_size_));
+        int count = std::min(page_size_, rows - first);
+        QVector<QVariant> values = source_->dataRange(column, first, count, Index(), role);
+        for ( int i = 0; i < values.size(); i++ )
+            insert(Key{first + i, column, role}, values[i]);
+    }
+
+    /**
+     * \brief Fetches the uncached rows from \p row in the current direction
+     *
+     * Stops at the first cached row or after a page.
+     */
+    void fetchMissing(int row, int column, int role) const
+    {
+        int rows = rowCount();
+        int count = 0;
+        for ( int i = row; count < page_size_ && i >= 0 && i < rows &&
+                           !entries_.contains(Key{i, column, role}); i += direction_ )
+            count++;
+        if ( count == 0 )
+            return;
+
+        int first = direction_ < 0 ? row - count + 1 : row;
+        QVector<QVariant> values = source_->dataRange(column, first, count, Index(), role);
+        for ( int i = 0; i < values.size(); i++ )
+            insert(Key{first + i, column, role}, values[i]);
+    }
+
+    void insert(const Key& key, const QVariant& value) const
+    {
+        auto iter = entries_.find(key);
+        if ( iter != entries_.end() )
+        {
+            cost_ -= iter->cost;
+            iter->value = value;
+            iter->cost = valueCost(value);
+            cost_ += iter->cost;
+            lru_.splice(lru_.begin(), lru_, iter->lru);
+        }
+        else
+        {
+            lru_.push_front(key);
+            Entry entry{value, valueCost(value), lru_.begin()};
+            cost_ += entry.cost;
+            entries_.insert(key, entry);
+        }
+        evict();
+    }
+
+    void remove(const Key& key)
+    {
+        auto iter = entries_.find(key);
+        if ( iter != entries_.end() )
+        {
+            cost_ -= iter->cost;
+            lru_.erase(iter->lru);
+            entries_.erase(iter);
+        }
+    }
+
+    /**
+     * \brief Drops the least recently used values until the cache fits in the budget
+     */
+    void evict() const
+    {
+        while ( cost_ > budget_ && !lru_.empty() )
+        {
+            auto iter = entries_.find(lru_.back());
+            cost_ -= iter->cost;
+            entries_.erase(iter);
+            lru_.pop_back();
+        }
+    }
+
+    /**
+     * \brief Replaces every key with \p relabel(key), dropping entries relabeled to null
+     */
+    template<class Func>
+        void relabel(const Func& func)
+        {
+            QHash<Key, Entry> entries;
+            entries.reserve(entries_.size());
+            for ( auto iter = entries_.begin(); iter != entries_.end(); ++iter )
+            {
+                Key key = iter.key();
+                if ( func(key) )
+                {
+                    *iter->lru = key;
+                    entries.insert(key, *iter);
+                }
+                else
+                {
+                    cost_ -= iter->cost;
+                    lru_.erase(iter->lru);
+                }
+            }
+            entries_.swap(entries);
+        }
+
+    void onSourceDataChanged(const Index& index, const QVariant& value, int role)
+    {
+        if ( index.parent().valid() )
+            return;
+        remove(Key{index.row(), index.column(), role});
+        notifyDataChanged(this->index(index.row(), index.column()), value, role);
+    }
+
+    void onSourceDataRangeChanged(int row, int column, int row_count, int column_count,
+                                  const Index& parent, int role)
+    {
+        if ( parent.valid() )
+            return;
+
+        relabel([=](Key& key) {
+            return key.row < row || key.row >= row + row_count ||
+                   key.column < column || key.column >= column + column_count ||
+                   (role != -1 && key.role != role);
+        });
+        notifyDataRangeChanged(row, column, row_count, column_count, Index(), role);
+    }
+
+    void onSourceRowsAdded(int row, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        relabel([=](Key& key) {
+            if ( key.row >= row )
+                key.row += count;
+            return true;
+        });
+        notifyRowsAdded(row, count, Index());
+    }
+
+    void onSourceRowsRemoved(int row, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        relabel([=](Key& key) {
+            if ( key.row >= row && key.row < row + count )
+                return false;
+            if ( key.row >= row + count )
+                key.row -= count;
+            return true;
+        });
+        notifyRowsRemoved(row, count, Index());
+    }
+
+    void onSourceRowsShifted(int removed, int added, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        // The rows added at the bottom aren't cached yet
+        relabel([=](Key& key) {
+            key.row -= removed;
+            return key.row >= 0;
+        });
+        notifyRowsShifted(removed, added, Index());
+    }
+
+    void onSourceRowsMoved(const Index& from_parent, int from_row, int count,
+                           const Index& to_parent, int to_row)
+    {
+        if ( from_parent.valid() || to_parent.valid() )
+            return;
+        relabel([=](Key& key) {
+            key.row = detail::movedIndex(key.row, from_row, count, to_row);
+            return true;
+        });
+        notifyRowsMoved(Index(), from_row, count, Index(), to_row);
+    }
+
+    void onSourceColumnsAdded(int column, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        relabel([=](Key& key) {
+            if ( key.column >= column )
+                key.column += count;
+            return true;
+        });
+        notifyColumnsAdded(column, count, Index());
+    }
+
+    void onSourceColumnsRemoved(int column, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        relabel([=](Key& key) {
+            if ( key.column >= column && key.column < column + count )
+                return false;
+            if ( key.column >= column + count )
+                key.column -= count;
+            return true;
+        });
+        notifyColumnsRemoved(column, count, Index());
+    }
+
+    void onSourceColumnsMoved(const Index& from_parent, int from_column, int count,
+                              const Index& to_parent, int to_column)
+    {
+        if ( from_parent.valid() || to_parent.valid() )
+            return;
+        relabel([=](Key& key) {
+            key.column = detail::movedIndex(key.column, from_column, count, to_column);
+            return true;
+        });
+        notifyColumnsMoved(Index(), from_column, count, Index(), to_column);
+    }
+
+    void onSourceModelReset()
+    {
+        clear();
+        endReset();
+    }
+
+    void onSourceLayoutAboutToChange(const Index& parent)
+    {
+        if ( !parent.valid() )
+            beginLayoutChange();
+    }
+
+    void onSourceLayoutChanged(const Index& parent, const QVector<int>& permutation)
+    {
+        if ( parent.valid() )
+            return;
+        if ( permutation.isEmpty() )
+        {
+            clear();
+        }
+        else
+        {
+            relabel([&](Key& key) {
+                if ( key.row >= permutation.size() )
+                    return false;
+                key.row = permutation[key.row];
+                return true;
+            });
+        }
+        endLayoutChange(Index(), permutation);
+    }
+
+    Model* source_ = nullptr;
+    std::size_t budget_;
+    int page_size_;
+    mutable QHash<Key, Entry> entries_;
+    /// Most recently used at the front
+    mutable std::list<Key> lru_;
+    mutable std::size_t cost_ = 0;
+    mutable int last_row_ = 0;
+    mutable int direction_ = 1;
+    mutable qint64 hits_ = 0;
+    mutable qint64 misses_ = 0;
+};
+
+} // namespace imv
+#endif // IMV_CACHING_PROXY_MODEL_HPP
@@ -0,0 +1,223 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_CELL_PAINTER_HPP
+#define IMV_CELL_PAINTER_HPP
+
+#include <QCache>
+#include <QFont>
+#include <QPainter>
+#include <QRect>
+#include <QStaticText>
+#include <QTransform>
+#include "model.hpp"
+
+namespace imv {
+
+/**
+ * \brief Paints the text of model items, caching the laid out text
+ *
+ * Two caches are kept:
+ *  - the text of each item, so data() isn't called again while the item
+ *    doesn't change;
+ *  - the laid out QStaticText, keyed by text, role, width and font,
+ *    shared between all the items showing the same text.
+ *
+ * Both caches are bounded and drop the least recently used entries.
+ * dataChanged() only drops the text of the affected item,
+ * structural changes drop all the item texts but keep the layouts.
+ */
+class CellPainter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * \param model         Model to read the items from
+     * \param text_limit    Maximum number of items with cached text
+     * \param layout_limit  Maximum number of cached layouts
+     */
+    explicit CellPainter(Model* model, int text_limit = 65536, int layout_limit = 4096)
+        : model_(model),
+          font_key_(font_.key())
+    {
+        texts_.setMaxCost(text_limit);
+        layouts_.setMaxCost(layout_limit);
+
+        connect(model, &Model::dataChanged, this, &CellPainter::onDataChanged);
+        connect(model, &Model::dataRangeChanged, this, &CellPainter::onDataRangeChanged);
+        connect(model, &Model::rowsAdded, this, &CellPainter::clearTexts);
+        connect(model, &Model::rowsRemoved, this, &CellPainter::clearTexts);
+        connect(model, &Model::rowsShifted, this, &CellPainter::clearTexts);
+        connect(model, &Model::rowsMoved, this, &CellPainter::clearTexts);
+        connect(model, &Model::columnsAdded, this, &CellPainter::clearTexts);
+        connect(model, &Model::columnsRemoved, this, &CellPainter::clearTexts);
+        connect(model, &Model::columnsMoved, this, &CellPainter::clearTexts);
+        connect(model, &Model::modelReset, this, &CellPainter::clearTexts);
+        connect(model, &Model::layoutChanged, this, &CellPainter::clearTexts);
+    }
+
+    /**
+     * \brief Draws the text for \p index in \p rect
+     *
+     * Uses the painter font and pen, the text is wrapped to the width of
+     * \p rect, vertically centered and clipped to it.
+     */
+    void paint(QPainter* painter, const QRect& rect, const Index& index, int role = Value)
+    {
+        QString text = cellText(index, role);
+        if ( text.isEmpty() )
+            return;
+
+        if ( painter->font() != font_ )
+        {
+            font_ = painter->font();
+            font_key_ = font_.key();
+        }
+
+        LayoutKey key{text, role, rect.width(), font_key_};
+        QStaticText* layout = layouts_.object(key);
+        if ( !layout )
+        {
+            layout = new QStaticText(text);
+            layout->setTextFormat(Qt::PlainText);
+            layout->setTextWidth(rect.width());
+            layout->prepare(QTransform(), font_);
+            layouts_.insert(key, layout);
+        }
+
+        qreal top = rect.top() + (rect.height() - layout->size().height()) / 2;
+        painter->save();
+        painter->setClipRect(rect, Qt::IntersectClip);
+        painter->drawStaticText(QPointF(rect.left(), top), *layout);
+        painter->restore();
+    }
+
+    /**
+     * \brief Drops all the cached text and layouts
+     */
+    void clear()
+    {
+        clearTexts();
+        layouts_.clear();
+    }
+
+    /**
+     * \brief Number of items with cached text
+     */
+    int textCount() const
+    {
+        return texts_.size();
+    }
+
+    /**
+     * \brief Number of cached layouts
+     */
+    int layoutCount() const
+    {
+        return layouts_.size();
+    }
+
+private:
+    struct CellKey
+    {
+        int row;
+        int column;
+        int role;
+        quintptr parent;
+
+        bool operator==(const CellKey& other) const
+        {
+            return row == other.row && column == other.column &&
+                   role == other.role && parent == other.parent;
+        }
+
+        friend uint qHash(const CellKey& key, uint seed = 0)
+        {
+            return qHash(quint64(key.row) << 32 | uint(key.column), seed) ^
+                   qHash(quint64(key.parent), seed) ^ uint(key.role);
+        }
+    };
+
+    struct LayoutKey
+    {
+        QString text;
+        int role;
+        int width;
+        QString font;
+
+        bool operator==(const LayoutKey& other) const
+        {
+            return role == other.role && width == other.width &&
+                   text == other.text && font == other.font;
+        }
+
+        friend uint qHash(const LayoutKey& key, uint seed = 0)
+        {
+            return qHash(key.text, seed) ^ qHash(key.font, seed) ^
+                   uint(key.width) * 31 ^ uint(key.role);
+        }
+    };
+
+    QString cellText(const Index& index, int role)
+    {
+        CellKey key{index.row(), index.column(), role, index.parent().internalId()};
+        if ( QString* text = texts_.object(key) )
+            return *text;
+        QString text = model_->data(index, role).toString();
+        texts_.insert(key, new QString(text));
+        return text;
+    }
+
+    void onDataChanged(const Index& index, const QVariant&, int role)
+    {
+        texts_.remove(CellKey{index.row(), index.column(), role,
+                              index.parent().internalId()});
+    }
+
+    void onDataRangeChanged(int row, int column, int row_count, int column_count,
+                            const Index& parent, int role)
+    {
+        // Walking a large range costs more than rebuilding the texts
+        if ( role == -1 || qint64(row_count) * column_count > texts_.size() )
+        {
+            clearTexts();
+            return;
+        }
+
+        for ( int r = row; r < row + row_count; r++ )
+            for ( int c = column; c < column + column_count; c++ )
+                texts_.remove(CellKey{r, c, role, parent.internalId()});
+    }
+
+    void clearTexts()
+    {
+        texts_.clear();
+    }
+
+    Model* model_;
+    QCache<CellKey, QString> texts_;
+    QCache<LayoutKey, QStaticText> layouts_;
+    QFont font_;
+    QString font_key_;
+};
+
+} // namespace imv
+#endif // IMV_CELL_PAINTER_HPP
@@ -0,0 +1,263 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_CELL_POOL_HPP
+#define IMV_CELL_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace imv {
+
+/**
+ * \brief Allocation statistics of a CellPool
+ */
+struct PoolStats
+{
+    /// Bytes obtained from the system, including unused arena space
+    std::size_t reserved = 0;
+    /// Bytes currently handed out
+    std::size_t used = 0;
+    /// Number of allocations served so far
+    std::size_t allocations = 0;
+    /// Number of deallocations so far
+    std::size_t deallocations = 0;
+    /// Number of arenas currently allocated
+    int arenas = 0;
+};
+
+/**
+ * \brief Arena allocator with power-of-two size classes
+ *
+ * Small requests are carved out of large arenas and recycled through
+ * per-class free lists, requests larger than the biggest class go
+ * straight to the global heap.
+ * Arenas are returned to the system all at once by release(), or by
+ * trim() once nothing allocated from them is alive.
+ *
+ * Not thread safe, like the models using it.
+ */
+class CellPool
+{
+public:
+    enum
+    {
+        min_size = 16,              ///< Size of the smallest class
+        size_classes = 12,          ///< Classes from 16 bytes to 32 KiB
+        arena_size = 256 * 1024,    ///< Bytes in each arena
+    };
+
+    CellPool() = default;
+    CellPool(const CellPool&) = delete;
+    CellPool& operator=(const CellPool&) = delete;
+
+    /**
+     * \brief Allocates at least \p size bytes
+     */
+    void* allocate(std::size_t size)
+    {
+        int size_class = sizeClass(size);
+        stats_.allocations++;
+
+        if ( size_class < 0 )
+        {
+            stats_.reserved += size;
+            stats_.used += size;
+            large_ += size;
+            return ::operator new(size);
+        }
+
+        std::size_t class_size = std::size_t(min_size) << size_class;
+        stats_.used += class_size;
+
+        if ( FreeNode* node = free_[size_class] )
+        {
+            free_[size_class] = node->next;
+            return node;
+        }
+
+        if ( std::size_t(arena_end_ - cursor_) < class_size )
+        {
+            arenas_.emplace_back(new char[arena_size]);
+            cursor_ = arenas_.back().get();
+            arena_end_ = cursor_ + arena_size;
+            stats_.reserved += arena_size;
+            stats_.arenas++;
+        }
+
+        void* block = cursor_;
+        cursor_ += class_size;
+        return block;
+    }
+
+    /**
+     * \brief Returns memory obtained from allocate() with the same \p size
+     */
+    void deallocate(void* block, std::size_t size)
+    {
+        if ( !block )
+            return;
+
+        int size_class = sizeClass(size);
+        stats_.deallocations++;
+
+        if ( size_class < 0 )
+        {
+            stats_.reserved -= size;
+            stats_.used -= size;
+            large_ -= size;
+            ::operator delete(block);
+            return;
+        }
+
+        stats_.used -= std::size_t(min_size) << size_class;
+        FreeNode* node = static_cast<FreeNode*>(block);
+        node->next = free_[size_class];
+        free_[size_class] = node;
+    }
+
+    /**
+     * \brief Returns all the arenas to the system at once
+     *
+     * Whatever has been allocated from the arenas is lost, it must not be
+     * used nor deallocated afterwards. Blocks larger than the biggest class
+     * come from the global heap and aren't affected.
+     */
+    void release()
+    {
+        stats_.reserved -= std::size_t(stats_.arenas) * arena_size;
+        stats_.used = large_;
+        stats_.arenas = 0;
+        arenas_.clear();
+        cursor_ = arena_end_ = nullptr;
+        std::fill(std::begin(free_), std::end(free_), nullptr);
+    }
+
+    /**
+     * \brief Releases all the arenas if none of their blocks is alive
+     * \returns \b true if the arenas have been released
+     */
+    bool trim()
+    {
+        if ( stats_.used != large_ )
+            return false;
+        release();
+        return true;
+    }
+
+    const PoolStats& stats() const
+    {
+        return stats_;
+    }
+
+private:
+    struct FreeNode
+    {
+        FreeNode* next;
+    };
+
+    /**
+     * \brief Index of the smallest class fitting \p size, -1 if too large
+     */
+    static int sizeClass(std::size_t size)
+    {
+        int size_class = 0;
+        while ( (std::size_t(min_size) << size_class) < size )
+        {
+            if ( ++size_class == size_classes )
+                return -1;
+        }
+        return size_class;
+    }
+
+    std::vector<std::unique_ptr<char[]>> arenas_;
+    char* cursor_ = nullptr;
+    char* arena_end_ = nullptr;
+    FreeNode* free_[size_classes] = {};
+    /// Bytes of the live blocks larger than the biggest class
+    std::size_t large_ = 0;
+    PoolStats stats_;
+};
+
+/**
+ * \brief Standard allocator drawing from a CellPool
+ *
+ * Without a pool it falls back to the global heap.
+ */
+template<class T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    PoolAllocator(CellPool* pool = nullptr) noexcept
+        : pool_(pool)
+    {}
+
+    template<class U>
+        PoolAllocator(const PoolAllocator<U>& other) noexcept
+            : pool_(other.pool())
+        {}
+
+    T* allocate(std::size_t count)
+    {
+        std::size_t size = count * sizeof(T);
+        return static_cast<T*>(pool_ ? pool_->allocate(size) : ::operator new(size));
+    }
+
+    void deallocate(T* block, std::size_t count)
+    {
+        if ( pool_ )
+            pool_->deallocate(block, count * sizeof(T));
+        else
+            ::operator delete(block);
+    }
+
+    CellPool* pool() const
+    {
+        return pool_;
+    }
+
+    template<class U>
+        bool operator==(const PoolAllocator<U>& other) const
+        {
+            return pool_ == other.pool();
+        }
+
+    template<class U>
+        bool operator!=(const PoolAllocator<U>& other) const
+        {
+            return pool_ != other.pool();
+        }
+
+private:
+    CellPool* pool_;
+};
+
+} // namespace imv
+#endif // IMV_CELL_POOL_HPP
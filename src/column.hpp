@@ -0,0 +1,425 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_COLUMN_HPP
+#define IMV_COLUMN_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include <QVariant>
+#include "bitmap.hpp"
+#include "cell_pool.hpp"
+#include "row_sequence.hpp"
+
+namespace imv {
+
+namespace detail {
+
+/**
+ * \brief Moves \p count elements starting at \p row before \p to_row
+ *
+ * \p to_row is expressed in the coordinates before the move,
+ * it must not be in the range being moved.
+ */
+template<class Container>
+    void moveRange(Container& container, int row, int count, int to_row)
+    {
+        auto begin = container.begin();
+        if ( to_row > row + count )
+            std::rotate(begin + row, begin + row + count, begin + to_row);
+        else if ( to_row < row )
+            std::rotate(begin + to_row, begin + row, begin + row + count);
+    }
+
+/**
+ * \brief Position of \p index after moving \p count elements from \p row before \p to_row
+ *
+ * Uses the same conventions as moveRange().
+ */
+inline int movedIndex(int index, int row, int count, int to_row)
+{
+    if ( to_row > row + count )
+    {
+        if ( index >= row && index < row + count )
+            return index + to_row - row - count;
+        if ( index >= row + count && index < to_row )
+            return index - count;
+    }
+    else if ( to_row < row )
+    {
+        if ( index >= row && index < row + count )
+            return index - row + to_row;
+        if ( index >= to_row && index < row )
+            return index + count;
+    }
+    return index;
+}
+
+/**
+ * \brief Converts \p variant to an integer, failing if it doesn't fit in \p Int
+ *
+ * QVariant::canConvert() only tells whether the types are convertible,
+ * these check that this particular value converts.
+ */
+template<class Int>
+    typename std::enable_if<std::is_integral<Int>::value && !std::is_same<Int, bool>::value, bool>::type
+        fromVariant(const QVariant& variant, Int& value)
+    {
+        bool ok = false;
+        if ( std::is_signed<Int>::value )
+        {
+            qint64 converted = variant.toLongLong(&ok);
+            if ( !ok || converted < qint64(std::numeric_limits<Int>::min()) ||
+                 converted > qint64(std::numeric_limits<Int>::max()) )
+                return false;
+            value = Int(converted);
+        }
+        else
+        {
+            quint64 converted = variant.toULongLong(&ok);
+            if ( !ok || converted > quint64(std::numeric_limits<Int>::max()) )
+                return false;
+            value = Int(converted);
+        }
+        return true;
+    }
+
+template<class Float>
+    typename std::enable_if<std::is_floating_point<Float>::value, bool>::type
+        fromVariant(const QVariant& variant, Float& value)
+    {
+        bool ok = false;
+        double converted = variant.toDouble(&ok);
+        if ( ok )
+            value = Float(converted);
+        return ok;
+    }
+
+template<class T>
+    typename std::enable_if<!std::is_arithmetic<T>::value || std::is_same<T, bool>::value, bool>::type
+        fromVariant(const QVariant& variant, T& value)
+    {
+        QVariant converted = variant;
+        if ( !converted.convert(qMetaTypeId<T>()) )
+            return false;
+        value = converted.value<T>();
+        return true;
+    }
+
+} // namespace detail
+
+/**
+ * \brief Storage for a single column of a TableModel
+ *
+ * Rows are always passed already validated by the model.
+ */
+class Column
+{
+public:
+    virtual ~Column(){}
+
+    /**
+     * \brief Number of rows stored in the column
+     */
+    virtual int size() const = 0;
+
+    /**
+     * \brief Value at the given row
+     */
+    virtual QVariant data(int row) const = 0;
+
+    /**
+     * \brief Sets the value at the given row
+     * \returns \b true on success
+     */
+    virtual bool setData(int row, const QVariant& value) = 0;
+
+    /**
+     * \brief Whether the given row has no value
+     */
+    virtual bool isNull(int row) const
+    {
+        return !data(row).isValid();
+    }
+
+    /**
+     * \brief Bitmap with a bit set for each null value in the given rows
+     */
+    virtual Bitmap nullMask(int row, int count) const
+    {
+        Bitmap mask(count);
+        for ( int i = 0; i < count; i++ )
+            mask.set(i, isNull(row + i));
+        return mask;
+    }
+
+    /**
+     * \brief Inserts \p count empty values before \p row
+     */
+    virtual void insertRows(int row, int count) = 0;
+
+    /**
+     * \brief Removes \p count values starting from \p row
+     */
+    virtual void removeRows(int row, int count) = 0;
+
+    /**
+     * \brief Moves \p count values starting from \p row before \p to_row
+     */
+    virtual void moveRows(int row, int count, int to_row) = 0;
+
+    /**
+     * \brief Removes all the values, dropping their storage
+     */
+    virtual void clear()
+    {
+        removeRows(0, size());
+    }
+};
+
+/**
+ * \brief Column storing arbitrary values
+ *
+ * Values are kept in a RowSequence so inserting, removing and moving rows
+ * in the middle of large columns doesn't shift the whole tail.
+ *
+ * Numbers are stored in the cells themselves, the characters of strings and
+ * byte arrays are copied to blocks allocated from the pool and other types
+ * are boxed in a QVariant allocated from the pool, so the payloads share
+ * the pool arenas instead of being scattered over the heap.
+ */
+class VariantColumn : public Column
+{
+public:
+    /**
+     * \param pool Pool for the value storage, if not null it must outlive the column
+     */
+    explicit VariantColumn(CellPool* pool = nullptr)
+        : pool_(pool),
+          cells_(Sequence::default_block_size, PoolAllocator<Cell>(pool))
+    {}
+
+    VariantColumn(const VariantColumn&) = delete;
+    VariantColumn& operator=(const VariantColumn&) = delete;
+
+    ~VariantColumn()
+    {
+        clear();
+    }
+
+    int size() const override
+    {
+        return cells_.size();
+    }
+
+    QVariant data(int row) const override
+    {
+        const Cell& cell = cells_[row];
+        switch ( cell.type )
+        {
+            case QMetaType::UnknownType:
+                return QVariant();
+            case QMetaType::Bool:
+                return QVariant(bool(cell.integer));
+            case QMetaType::Int:
+                return QVariant(int(cell.integer));
+            case QMetaType::UInt:
+                return QVariant(uint(cell.integer));
+            case QMetaType::LongLong:
+                return QVariant(qint64(cell.integer));
+            case QMetaType::ULongLong:
+                return QVariant(quint64(cell.integer));
+            case QMetaType::Double:
+                return QVariant(cell.real);
+            case QMetaType::QString:
+                if ( cell.size < 0 )
+                    return QVariant(QString());
+                return QVariant(QString(static_cast<const QChar*>(cell.payload), cell.size));
+            case QMetaType::QByteArray:
+                if ( cell.size < 0 )
+                    return QVariant(QByteArray());
+                return QVariant(QByteArray(static_cast<const char*>(cell.payload), cell.size));
+            default:
+                return *static_cast<const QVariant*>(cell.payload);
+        }
+    }
+
+    bool setData(int row, const QVariant& value) override
+    {
+        Cell cell = encode(value);
+        freeCell(cells_[row]);
+        cells_[row] = cell;
+        return true;
+    }
+
+    bool isNull(int row) const override
+    {
+        return cells_[row].type == QMetaType::UnknownType;
+    }
+
+    void insertRows(int row, int count) override
+    {
+        cells_.insert(row, count);
+    }
+
+    void removeRows(int row, int count) override
+    {
+        for ( int i = 0; i < count; i++ )
+            freeCell(cells_[row + i]);
+        cells_.erase(row, count);
+    }
+
+    void moveRows(int row, int count, int to_row) override
+    {
+        cells_.move(row, count, to_row);
+    }
+
+    void clear() override
+    {
+        for ( int row = 0; row < cells_.size(); row++ )
+            freeCell(cells_[row]);
+        cells_.clear();
+    }
+
+private:
+    /**
+     * \brief Stored value, \c type is a QMetaType id or \c boxed
+     *
+     * Strings and byte arrays keep their length in \c size, -1 for null ones.
+     */
+    struct Cell
+    {
+        int type = QMetaType::UnknownType;
+        int size = 0;
+        union
+        {
+            qint64 integer = 0;
+            double real;
+            void* payload;
+        };
+    };
+
+    enum { boxed = -1 };
+
+    typedef RowSequence<Cell, PoolAllocator<Cell>> Sequence;
+
+    void* allocate(std::size_t size)
+    {
+        return pool_ ? pool_->allocate(size) : ::operator new(size);
+    }
+
+    void deallocate(void* block, std::size_t size)
+    {
+        if ( pool_ )
+            pool_->deallocate(block, size);
+        else
+            ::operator delete(block);
+    }
+
+    /**
+     * \brief Copies \p size bytes into a new block, null if there are none
+     */
+    void* copy(const void* data, int size)
+    {
+        if ( size <= 0 )
+            return nullptr;
+        void* block = allocate(size);
+        std::memcpy(block, data, size);
+        return block;
+    }
+
+    static int payloadSize(const Cell& cell)
+    {
+        return cell.type == QMetaType::QString ? cell.size * int(sizeof(QChar)) : cell.size;
+    }
+
+    Cell encode(const QVariant& value)
+    {
+        Cell cell;
+        if ( !value.isValid() )
+            return cell;
+
+        cell.type = value.userType();
+        switch ( cell.type )
+        {
+            case QMetaType::Bool:
+                cell.integer = value.toBool();
+                break;
+            case QMetaType::Int:
+                cell.integer = value.toInt();
+                break;
+            case QMetaType::UInt:
+                cell.integer = value.toUInt();
+                break;
+            case QMetaType::LongLong:
+                cell.integer = value.toLongLong();
+                break;
+            case QMetaType::ULongLong:
+                cell.integer = qint64(value.toULongLong());
+                break;
+            case QMetaType::Double:
+                cell.real = value.toDouble();
+                break;
+            case QMetaType::QString:
+            {
+                QString string = value.toString();
+                cell.size = string.isNull() ? -1 : string.size();
+                cell.payload = copy(string.constData(), payloadSize(cell));
+                break;
+            }
+            case QMetaType::QByteArray:
+            {
+                QByteArray bytes = value.toByteArray();
+                cell.size = bytes.isNull() ? -1 : bytes.size();
+                cell.payload = copy(bytes.constData(), payloadSize(cell));
+                break;
+            }
+            default:
+                cell.type = boxed;
+                cell.payload = new (allocate(sizeof(QVariant))) QVariant(value);
+                break;
+        }
+        return cell;
+    }
+
+    void freeCell(Cell& cell)
+    {
+        if ( cell.type == boxed )
+        {
+            QVariant* variant = static_cast<QVariant*>(cell.payload);
+            variant->~QVariant();
+            deallocate(variant, sizeof(QVariant));
+        }
+        else if ( (cell.type == QMetaType::QString || cell.type == QMetaType::QByteArray) && cell.size > 0 )
+        {
+            deallocate(cell.payload, payloadSize(cell));
+        }
+        cell = Cell();
+    }
+
+    CellPool* pool_;
+    Sequence cells_;
+};
+
+} // namespace imv
+#endif // IMV_COLUMN_HPP
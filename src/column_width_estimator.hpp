@@ -0,0 +1,241 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_COLUMN_WIDTH_ESTIMATOR_HPP
+#define IMV_COLUMN_WIDTH_ESTIMATOR_HPP
+
+#include <algorithm>
+#include <vector>
+#include <QFont>
+#include <QFontMetrics>
+#include "model.hpp"
+#include "column.hpp"
+
+namespace imv {
+
+/**
+ * \brief Estimates the width needed to show the top-level columns of a model
+ *
+ * Instead of measuring every item, the estimate combines a sample of rows
+ * spread over the whole column, the visible rows and the widest values
+ * seen through dataChanged(). Once known, a width only grows until the
+ * column is explicitly reset.
+ */
+class ColumnWidthEstimator : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * \param model         Model to measure
+     * \param font          Font used to measure the text
+     * \param sample_size   Maximum number of rows measured when estimating a column
+     */
+    explicit ColumnWidthEstimator(Model* model, const QFont& font = QFont(),
+                                  int sample_size = 1000)
+        : model_(model),
+          metrics_(font),
+          sample_size_(std::max(sample_size, 1)),
+          widths_(model->columnCount(), unknown)
+    {
+        connect(model, &Model::dataChanged, this, &ColumnWidthEstimator::onDataChanged);
+        connect(model, &Model::dataRangeChanged, this, &ColumnWidthEstimator::onDataRangeChanged);
+        connect(model, &Model::columnsAdded, this, &ColumnWidthEstimator::onColumnsAdded);
+        connect(model, &Model::columnsRemoved, this, &ColumnWidthEstimator::onColumnsRemoved);
+        connect(model, &Model::columnsMoved, this, &ColumnWidthEstimator::onColumnsMoved);
+        connect(model, &Model::modelReset, this, &ColumnWidthEstimator::onModelReset);
+    }
+
+    /**
+     * \brief Width for \p column, estimating it if not known yet
+     * \returns 0 if \p column is out of range
+     */
+    int width(int column)
+    {
+        if ( column < 0 || column >= int(widths_.size()) )
+            return 0;
+        if ( widths_[column] == unknown )
+            estimate(column);
+        return widths_[column];
+    }
+
+    /**
+     * \brief Sets the font used for measuring, resetting all the widths
+     */
+    void setFont(const QFont& font)
+    {
+        metrics_ = QFontMetrics(font);
+        reset();
+    }
+
+    /**
+     * \brief Extra space added to the text width
+     */
+    void setMargin(int margin)
+    {
+        margin_ = margin;
+        reset();
+    }
+
+    /**
+     * \brief Measures the visible rows, growing the known widths
+     */
+    void setVisibleRows(int row, int count)
+    {
+        row = std::max(row, 0);
+        count = std::min(count, model_->rowCount() - row);
+        for ( int column = 0; column < int(widths_.size()); column++ )
+        {
+            if ( widths_[column] != unknown )
+                grow(column, measure(column, row, count, 1));
+        }
+        visible_row_ = row;
+        visible_count_ = std::max(count, 0);
+    }
+
+    /**
+     * \brief Forgets the width of \p column, allowing it to shrink
+     */
+    void reset(int column)
+    {
+        if ( column >= 0 && column < int(widths_.size()) )
+            widths_[column] = unknown;
+    }
+
+    /**
+     * \brief Forgets all the widths
+     */
+    void reset()
+    {
+        std::fill(widths_.begin(), widths_.end(), int(unknown));
+    }
+
+signals:
+    /**
+     * \brief Emitted when a known width grows
+     */
+    void widthChanged(int column, int width);
+
+private:
+    enum { unknown = -1 };
+
+    /**
+     * \brief Computes the width of \p column from a sample and the visible rows
+     */
+    void estimate(int column)
+    {
+        int rows = model_->rowCount();
+        int stride = std::max(1, (rows + sample_size_ - 1) / sample_size_);
+        int width = measure(column, 0, rows, stride);
+
+        int visible = std::min(visible_count_, rows - visible_row_);
+        if ( visible > 0 )
+            width = std::max(width, measure(column, visible_row_, visible, 1));
+
+        // The last row is often a total or the longest id
+        if ( rows > 0 )
+            width = std::max(width, measure(column, rows - 1, 1, 1));
+
+        widths_[column] = width;
+    }
+
+    /**
+     * \brief Widest item among the rows in [row, row+count) taken every \p stride
+     */
+    int measure(int column, int row, int count, int stride) const
+    {
+        int width = margin_;
+        for ( int i = row; i < row + count; i += stride )
+            width = std::max(width, textWidth(model_->data(model_->index(i, column))));
+        return width;
+    }
+
+    int textWidth(const QVariant& value) const
+    {
+        if ( !value.isValid() )
+            return margin_;
+        return metrics_.horizontalAdvance(value.toString()) + margin_;
+    }
+
+    void grow(int column, int width)
+    {
+        if ( widths_[column] != unknown && width > widths_[column] )
+        {
+            widths_[column] = width;
+            emit widthChanged(column, width);
+        }
+    }
+
+    void onDataChanged(const Index& index, const QVariant& value, int role)
+    {
+        if ( role == Value && !model_->parent(index).valid() &&
+             index.column() < int(widths_.size()) )
+            grow(index.column(), textWidth(value));
+    }
+
+    void onDataRangeChanged(int row, int column, int row_count, int column_count,
+                            const Index& parent, int role)
+    {
+        if ( parent.valid() || (role != Value && role != -1) )
+            return;
+        int stride = std::max(1, (row_count + sample_size_ - 1) / sample_size_);
+        for ( int c = column; c < column + column_count && c < int(widths_.size()); c++ )
+        {
+            if ( widths_[c] != unknown )
+                grow(c, measure(c, row, row_count, stride));
+        }
+    }
+
+    void onColumnsAdded(int column, int count, const Index& parent)
+    {
+        if ( !parent.valid() )
+            widths_.insert(widths_.begin() + column, count, int(unknown));
+    }
+
+    void onColumnsRemoved(int column, int count, const Index& parent)
+    {
+        if ( !parent.valid() )
+            widths_.erase(widths_.begin() + column, widths_.begin() + column + count);
+    }
+
+    void onColumnsMoved(const Index& from_parent, int from_column, int count,
+                        const Index& to_parent, int to_column)
+    {
+        if ( !from_parent.valid() && !to_parent.valid() )
+            detail::moveRange(widths_, from_column, count, to_column);
+    }
+
+    void onModelReset()
+    {
+        widths_.assign(model_->columnCount(), int(unknown));
+        visible_row_ = visible_count_ = 0;
+    }
+
+    Model* model_;
+    QFontMetrics metrics_;
+    int sample_size_;
+    int margin_ = 8;
+    int visible_row_ = 0;
+    int visible_count_ = 0;
+    std::vector<int> widths_;
+};
+
+} // namespace imv
+#endif // IMV_COLUMN_WIDTH_ESTIMATOR_HPP
@@ -0,0 +1,677 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_COMPRESSED_COLUMN_HPP
+#define IMV_COMPRESSED_COLUMN_HPP
+
+#include <cstring>
+#include <list>
+#include <memory>
+#include <type_traits>
+#include <QByteArray>
+#include <QString>
+#include <QtAlgorithms>
+#include "column.hpp"
+#include "bitmap.hpp"
+
+namespace imv {
+
+namespace detail {
+
+/**
+ * \brief Writes values bit by bit, most significant bit first
+ */
+class BitWriter
+{
+public:
+    /**
+     * \brief Writes the lowest \p bits bits of \p value
+     */
+    void write(quint64 value, int bits)
+    {
+        while ( bits > 0 )
+        {
+            if ( used_ == 0 )
+                bytes_.append('\0');
+            int take = std::min(bits, 8 - used_);
+            quint8 chunk = (value >> (bits - take)) & ((1u << take) - 1);
+            bytes_.data()[bytes_.size() - 1] |= chunk << (8 - used_ - take);
+            used_ = (used_ + take) % 8;
+            bits -= take;
+        }
+    }
+
+    const QByteArray& bytes() const
+    {
+        return bytes_;
+    }
+
+private:
+    QByteArray bytes_;
+    int used_ = 0;
+};
+
+/**
+ * \brief Reads values written by BitWriter
+ */
+class BitReader
+{
+public:
+    explicit BitReader(const QByteArray& bytes)
+        : bytes_(bytes)
+    {}
+
+    quint64 read(int bits)
+    {
+        quint64 value = 0;
+        while ( bits > 0 )
+        {
+            int take = std::min(bits, 8 - used_);
+            quint8 byte = bytes_[pos_];
+            value = (value << take) | ((byte >> (8 - used_ - take)) & ((1u << take) - 1));
+            used_ += take;
+            if ( used_ == 8 )
+            {
+                used_ = 0;
+                pos_++;
+            }
+            bits -= take;
+        }
+        return value;
+    }
+
+private:
+    const QByteArray& bytes_;
+    int pos_ = 0;
+    int used_ = 0;
+};
+
+} // namespace detail
+
+/**
+ * \brief Delta and frame-of-reference encoding for integers
+ *
+ * Each value is stored as the difference from the previous one,
+ * deltas are offset by their minimum and bit-packed to the width
+ * of the largest one. Sorted or slowly changing data like timestamps
+ * packs to a few bits per row.
+ */
+template<class Int>
+struct IntegerCodec
+{
+    static_assert(std::is_integral<Int>::value && sizeof(Int) <= 8,
+                  "IntegerCodec requires an integer of at most 64 bits");
+
+    typedef Int value_type;
+
+    static QByteArray encode(const std::vector<Int>& values)
+    {
+        detail::BitWriter writer;
+        if ( values.empty() )
+            return writer.bytes();
+
+        std::vector<quint64> deltas(values.size() - 1);
+        quint64 min = ~quint64(0);
+        quint64 max = 0;
+        for ( std::size_t i = 1; i < values.size(); i++ )
+        {
+            quint64 delta = quint64(values[i]) - quint64(values[i-1]);
+            deltas[i-1] = (delta << 1) ^ quint64(qint64(delta) >> 63);
+            min = std::min(min, deltas[i-1]);
+            max = std::max(max, deltas[i-1]);
+        }
+
+        int bits = 0;
+        if ( !deltas.empty() )
+            for ( quint64 range = max - min; range; range >>= 1 )
+                bits++;
+
+        writer.write(quint64(values[0]), 64);
+        writer.write(min, 64);
+        writer.write(bits, 7);
+        for ( quint64 delta : deltas )
+            writer.write(delta - min, bits);
+        return writer.bytes();
+    }
+
+    static std::vector<Int> decode(const QByteArray& data, int count)
+    {
+        std::vector<Int> values;
+        if ( count == 0 )
+            return values;
+        values.reserve(count);
+
+        detail::BitReader reader(data);
+        quint64 value = reader.read(64);
+        quint64 min = reader.read(64);
+        int bits = reader.read(7);
+        values.push_back(Int(value));
+        for ( int i = 1; i < count; i++ )
+        {
+            quint64 delta = reader.read(bits) + min;
+            value += (delta >> 1) ^ (~(delta & 1) + 1);
+            values.push_back(Int(value));
+        }
+        return values;
+    }
+
+    static QVariant toVariant(Int value)
+    {
+        return QVariant::fromValue(value);
+    }
+
+    static bool fromVariant(const QVariant& variant, Int& value)
+    {
+        bool ok = false;
+        if ( std::is_signed<Int>::value )
+            value = Int(variant.toLongLong(&ok));
+        else
+            value = Int(variant.toULongLong(&ok));
+        return ok;
+    }
+};
+
+/**
+ * \brief XOR encoding for doubles as described in Facebook's Gorilla paper
+ *
+ * Each value is XORed with the previous one and only the meaningful bits
+ * of the result are stored, reusing the previous window when they fit.
+ */
+struct DoubleCodec
+{
+    typedef double value_type;
+
+    static QByteArray encode(const std::vector<double>& values)
+    {
+        detail::BitWriter writer;
+        if ( values.empty() )
+            return writer.bytes();
+
+        quint64 previous = bits(values[0]);
+        writer.write(previous, 64);
+        int window_lead = -1;
+        int window_trail = 0;
+        for ( std::size_t i = 1; i < values.size(); i++ )
+        {
+            quint64 current = bits(values[i]);
+            quint64 xored = current ^ previous;
+            previous = current;
+
+            if ( xored == 0 )
+            {
+                writer.write(0, 1);
+                continue;
+            }
+            writer.write(1, 1);
+
+            int lead = std::min<int>(qCountLeadingZeroBits(xored), 31);
+            int trail = qCountTrailingZeroBits(xored);
+            if ( window_lead != -1 && lead >= window_lead && trail >= window_trail )
+            {
+                writer.write(0, 1);
+                writer.write(xored >> window_trail, 64 - window_lead - window_trail);
+            }
+            else
+            {
+                int meaningful = 64 - lead - trail;
+                writer.write(1, 1);
+                writer.write(lead, 5);
+                writer.write(meaningful & 63, 6);
+                writer.write(xored >> trail, meaningful);
+                window_lead = lead;
+                window_trail = trail;
+            }
+        }
+        return writer.bytes();
+    }
+
+    static std::vector<double> decode(const QByteArray& data, int count)
+    {
+        std::vector<double> values;
+        if ( count == 0 )
+            return values;
+        values.reserve(count);
+
+        detail::BitReader reader(data);
+        quint64 previous = reader.read(64);
+        values.push_back(value(previous));
+        int window_lead = 0;
+        int window_trail = 0;
+        for ( int i = 1; i < count; i++ )
+        {
+            if ( reader.read(1) )
+            {
+                if ( reader.read(1) )
+                {
+                    window_lead = reader.read(5);
+                    int meaningful = reader.read(6);
+                    if ( meaningful == 0 )
+                        meaningful = 64;
+                    window_trail = 64 - window_lead - meaningful;
+                }
+                int meaningful = 64 - window_lead - window_trail;
+                previous ^= reader.read(meaningful) << window_trail;
+            }
+            values.push_back(value(previous));
+        }
+        return values;
+    }
+
+    static QVariant toVariant(double value)
+    {
+        return value;
+    }
+
+    static bool fromVariant(const QVariant& variant, double& value)
+    {
+        bool ok = false;
+        value = variant.toDouble(&ok);
+        return ok;
+    }
+
+private:
+    static quint64 bits(double value)
+    {
+        quint64 result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+
+    static double value(quint64 bits)
+    {
+        double result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+};
+
+/**
+ * \brief Stores strings as a zlib-compressed block of UTF-8
+ */
+struct StringCodec
+{
+    typedef QString value_type;
+
+    static QByteArray encode(const std::vector<QString>& values)
+    {
+        QByteArray raw;
+        for ( const QString& string : values )
+        {
+            QByteArray utf8 = string.toUtf8();
+            quint32 size = utf8.size();
+            raw.append(reinterpret_cast<const char*>(&size), sizeof(size));
+            raw.append(utf8);
+        }
+        return qCompress(raw);
+    }
+
+    static std::vector<QString> decode(const QByteArray& data, int count)
+    {
+        std::vector<QString> values;
+        if ( count == 0 )
+            return values;
+        values.reserve(count);
+        QByteArray raw = qUncompress(data);
+        const char* pos = raw.constData();
+        for ( int i = 0; i < count; i++ )
+        {
+            quint32 size;
+            std::memcpy(&size, pos, sizeof(size));
+            pos += sizeof(size);
+            values.push_back(QString::fromUtf8(pos, size));
+            pos += size;
+        }
+        return values;
+    }
+
+    static QVariant toVariant(const QString& value)
+    {
+        return value;
+    }
+
+    static bool fromVariant(const QVariant& variant, QString& value)
+    {
+        if ( !variant.canConvert<QString>() )
+            return false;
+        value = variant.toString();
+        return true;
+    }
+};
+
+/**
+ * \brief Column storing its values in independently compressed blocks
+ *
+ * \p Codec defines \c value_type and how a block of values is encoded.
+ * Blocks are decoded only when accessed and the most recently used
+ * ones are kept in a small cache, modified blocks are encoded again
+ * when they leave the cache or on flush().
+ */
+template<class Codec>
+class CompressedColumn : public Column
+{
+public:
+    typedef typename Codec::value_type value_type;
+
+    /**
+     * \param block_size    Number of rows in each block
+     * \param cache_blocks  Maximum number of decoded blocks kept in memory
+     */
+    explicit CompressedColumn(int block_size = 4096, int cache_blocks = 8)
+        : block_size_(std::max(block_size, 1)),
+          cache_blocks_(std::max(cache_blocks, 1))
+    {}
+
+    /**
+     * \brief Value at the given row
+     */
+    value_type value(int row) const
+    {
+        const Block* block = blocks_[blockIndex(row)].get();
+        return values(block, false)[row - block->start];
+    }
+
+    /**
+     * \brief Sets the value at the given row
+     */
+    void setValue(int row, const value_type& value)
+    {
+        const Block* block = blocks_[blockIndex(row)].get();
+        values(block, true)[row - block->start] = value;
+        valid_.set(row);
+    }
+
+    /**
+     * \brief Makes the given row null
+     */
+    void setNull(int row)
+    {
+        setValue(row, value_type());
+        valid_.set(row, false);
+    }
+
+    /**
+     * \brief Bitmap with bits set for rows which aren't null
+     */
+    const Bitmap& validity() const
+    {
+        return valid_;
+    }
+
+    /**
+     * \brief Encodes all modified blocks in the cache
+     */
+    void flush() const
+    {
+        for ( auto& entry : cache_ )
+            writeBack(entry);
+    }
+
+    /**
+     * \brief Drops all decoded blocks from the cache
+     */
+    void clearCache() const
+    {
+        flush();
+        cache_.clear();
+    }
+
+    /**
+     * \brief Number of bytes used by the encoded blocks
+     */
+    int compressedSize() const
+    {
+        flush();
+        int total = 0;
+        for ( const auto& block : blocks_ )
+            total += block->data.size();
+        return total;
+    }
+
+    int size() const override
+    {
+        return size_;
+    }
+
+    QVariant data(int row) const override
+    {
+        if ( !valid_.test(row) )
+            return QVariant();
+        return Codec::toVariant(value(row));
+    }
+
+    bool setData(int row, const QVariant& variant) override
+    {
+        if ( !variant.isValid() )
+        {
+            setNull(row);
+            return true;
+        }
+        value_type value;
+        if ( !Codec::fromVariant(variant, value) )
+            return false;
+        setValue(row, value);
+        return true;
+    }
+
+    bool isNull(int row) const override
+    {
+        return !valid_.test(row);
+    }
+
+    Bitmap nullMask(int row, int count) const override
+    {
+        Bitmap mask = valid_.slice(row, count);
+        mask.flip();
+        return mask;
+    }
+
+    void insertRows(int row, int count) override
+    {
+        insertValues(row, std::vector<value_type>(count));
+        valid_.insert(row, count, false);
+    }
+
+    void removeRows(int row, int count) override
+    {
+        removeValues(row, count);
+        valid_.remove(row, count);
+    }
+
+    void moveRows(int row, int count, int to_row) override
+    {
+        std::vector<value_type> moved;
+        moved.reserve(count);
+        for ( int i = 0; i < count; i++ )
+            moved.push_back(value(row + i));
+        removeValues(row, count);
+        insertValues(to_row > row ? to_row - count : to_row, moved);
+        valid_.move(row, count, to_row);
+    }
+
+private:
+    struct Block
+    {
+        QByteArray data;
+        int start = 0;
+        int size = 0;
+    };
+
+    struct CacheEntry
+    {
+        const Block* block;
+        std::vector<value_type> values;
+        bool dirty;
+    };
+
+    /**
+     * \brief Removes \p count values from the blocks starting at \p row
+     */
+    void removeValues(int row, int count)
+    {
+        int index = blockIndex(row);
+        int first = index;
+        int offset = row - blocks_[index]->start;
+        size_ -= count;
+        while ( count > 0 )
+        {
+            Block* block = blocks_[index].get();
+            int removed = std::min(count, block->size - offset);
+            if ( removed == block->size )
+            {
+                dropCache(block);
+                blocks_.erase(blocks_.begin() + index);
+            }
+            else
+            {
+                auto& vals = values(block, true);
+                vals.erase(vals.begin() + offset, vals.begin() + offset + removed);
+                block->size -= removed;
+                index++;
+            }
+            count -= removed;
+            offset = 0;
+        }
+        updateStarts(first);
+    }
+
+    /**
+     * \brief Index of the block containing \p row
+     */
+    int blockIndex(int row) const
+    {
+        auto iter = std::upper_bound(blocks_.begin(), blocks_.end(), row,
+            [](int row, const std::unique_ptr<Block>& block) {
+                return row < block->start;
+            });
+        return iter - blocks_.begin() - 1;
+    }
+
+    /**
+     * \brief Decoded values for \p block, marking it as recently used
+     */
+    std::vector<value_type>& values(const Block* block, bool write) const
+    {
+        for ( auto iter = cache_.begin(); iter != cache_.end(); ++iter )
+        {
+            if ( iter->block == block )
+            {
+                cache_.splice(cache_.begin(), cache_, iter);
+                cache_.front().dirty |= write;
+                return cache_.front().values;
+            }
+        }
+
+        cache_.push_front(CacheEntry{block, Codec::decode(block->data, block->size), write});
+        while ( int(cache_.size()) > cache_blocks_ )
+        {
+            writeBack(cache_.back());
+            cache_.pop_back();
+        }
+        return cache_.front().values;
+    }
+
+    /**
+     * \brief Encodes the values in \p entry if they have been modified
+     */
+    void writeBack(CacheEntry& entry) const
+    {
+        if ( entry.dirty )
+        {
+            const_cast<Block*>(entry.block)->data = Codec::encode(entry.values);
+            entry.dirty = false;
+        }
+    }
+
+    /**
+     * \brief Removes \p block from the cache without encoding it
+     */
+    void dropCache(const Block* block)
+    {
+        cache_.remove_if([block](const CacheEntry& entry) {
+            return entry.block == block;
+        });
+    }
+
+    /**
+     * \brief Inserts values in the blocks, splitting the target block if it grows too big
+     */
+    void insertValues(int row, const std::vector<value_type>& inserted)
+    {
+        int index = blocks_.empty() ? -1 : blockIndex(row == size_ ? row - 1 : row);
+        if ( index == -1 || (row == size_ && blocks_[index]->size >= block_size_) )
+        {
+            index++;
+            blocks_.emplace(blocks_.begin() + index, new Block);
+            blocks_[index]->start = row;
+        }
+
+        Block* block = blocks_[index].get();
+        auto& vals = values(block, true);
+        vals.insert(vals.begin() + (row - block->start), inserted.begin(), inserted.end());
+        block->size += inserted.size();
+        size_ += inserted.size();
+
+        if ( block->size > 2 * block_size_ )
+        {
+            std::vector<value_type> all = std::move(vals);
+            dropCache(block);
+            blocks_.erase(blocks_.begin() + index);
+            for ( int i = 0; i < int(all.size()); i += block_size_ )
+            {
+                std::unique_ptr<Block> split(new Block);
+                split->size = std::min<int>(block_size_, all.size() - i);
+                split->data = Codec::encode(std::vector<value_type>(
+                    all.begin() + i, all.begin() + i + split->size));
+                blocks_.insert(blocks_.begin() + index + i / block_size_, std::move(split));
+            }
+        }
+
+        updateStarts(index);
+    }
+
+    /**
+     * \brief Recomputes the starting rows of the blocks from \p index onwards
+     */
+    void updateStarts(int index)
+    {
+        int start = 0;
+        if ( index > 0 )
+            start = blocks_[index-1]->start + blocks_[index-1]->size;
+        for ( int i = index; i < int(blocks_.size()); i++ )
+        {
+            blocks_[i]->start = start;
+            start += blocks_[i]->size;
+        }
+    }
+
+    std::vector<std::unique_ptr<Block>> blocks_;
+    mutable std::list<CacheEntry> cache_;
+    int block_size_;
+    int cache_blocks_;
+    int size_ = 0;
+    Bitmap valid_;
+};
+
+typedef CompressedColumn<IntegerCodec<qint64>> CompressedIntColumn;
+typedef CompressedColumn<DoubleCodec> CompressedDoubleColumn;
+typedef CompressedColumn<StringCodec> CompressedStringColumn;
+
+} // namespace imv
+#endif // IMV_COMPRESSED_COLUMN_HPP
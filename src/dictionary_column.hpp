@@ -0,0 +1,242 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_DICTIONARY_COLUMN_HPP
+#define IMV_DICTIONARY_COLUMN_HPP
+
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "column.hpp"
+
+namespace imv {
+
+/**
+ * \brief Set of unique strings identified by integer codes
+ *
+ * Code 0 is reserved for the null value, strings are never removed
+ * so codes remain stable for the lifetime of the pool.
+ */
+class StringPool
+{
+public:
+    /**
+     * \brief Code representing the absence of a value
+     */
+    static constexpr quint32 null_code = 0;
+
+    StringPool()
+    {
+        strings_.push_back(QString());
+    }
+
+    /**
+     * \brief Returns the code for \p string, adding it if needed
+     */
+    quint32 intern(const QString& string)
+    {
+        auto iter = codes_.constFind(string);
+        if ( iter != codes_.constEnd() )
+            return *iter;
+        quint32 code = strings_.size();
+        strings_.push_back(string);
+        codes_.insert(string, code);
+        return code;
+    }
+
+    /**
+     * \brief Returns the code for \p string or null_code if not in the pool
+     */
+    quint32 find(const QString& string) const
+    {
+        return codes_.value(string, quint32(null_code));
+    }
+
+    /**
+     * \brief String associated with \p code
+     */
+    const QString& string(quint32 code) const
+    {
+        return strings_[code];
+    }
+
+    /**
+     * \brief Number of codes in use, including null_code
+     */
+    int size() const
+    {
+        return strings_.size();
+    }
+
+private:
+    QVector<QString>        strings_;
+    QHash<QString, quint32> codes_;
+};
+
+/**
+ * \brief Column storing strings as codes into a StringPool
+ *
+ * Suited for columns with few distinct values, each row only takes
+ * \c sizeof(Code) bytes and data() returns a shared copy of the pooled
+ * string. The pool can be shared among several columns.
+ */
+template<class Code>
+class DictionaryColumn : public Column
+{
+    static_assert(std::is_unsigned<Code>::value && sizeof(Code) <= sizeof(quint32),
+                  "Code must be an unsigned integer of at most 32 bits");
+
+public:
+    explicit DictionaryColumn(std::shared_ptr<StringPool> pool = {})
+        : pool_(pool ? std::move(pool) : std::make_shared<StringPool>())
+    {}
+
+    /**
+     * \brief Pool the codes refer to
+     */
+    const std::shared_ptr<StringPool>& pool() const
+    {
+        return pool_;
+    }
+
+    /**
+     * \brief Code stored at the given row
+     */
+    Code code(int row) const
+    {
+        return codes_[row];
+    }
+
+    /**
+     * \brief All the codes in row order, for filtering or grouping
+     */
+    const std::vector<Code>& codes() const
+    {
+        return codes_;
+    }
+
+    /**
+     * \brief String stored at the given row
+     */
+    const QString& string(int row) const
+    {
+        return pool_->string(codes_[row]);
+    }
+
+    /**
+     * \brief Sets the string at the given row
+     * \returns \b false if the pool has more strings than \p Code can represent
+     */
+    bool setString(int row, const QString& string)
+    {
+        // Check the code a new string would get, so rejected ones don't grow the pool
+        quint32 code = pool_->find(string);
+        if ( code == StringPool::null_code )
+        {
+            if ( quint32(pool_->size()) > std::numeric_limits<Code>::max() )
+                return false;
+            code = pool_->intern(string);
+        }
+        codes_[row] = code;
+        return true;
+    }
+
+    /**
+     * \brief Rows whose value is equal to \p string
+     */
+    std::vector<int> find(const QString& string) const
+    {
+        std::vector<int> rows;
+        quint32 code = pool_->find(string);
+        if ( code == StringPool::null_code )
+            return rows;
+        for ( int i = 0; i < int(codes_.size()); i++ )
+            if ( codes_[i] == code )
+                rows.push_back(i);
+        return rows;
+    }
+
+    /**
+     * \brief Number of rows for each code in the pool
+     */
+    std::vector<int> countByCode() const
+    {
+        std::vector<int> counts(pool_->size(), 0);
+        for ( Code code : codes_ )
+            counts[code]++;
+        return counts;
+    }
+
+    int size() const override
+    {
+        return codes_.size();
+    }
+
+    QVariant data(int row) const override
+    {
+        if ( codes_[row] == StringPool::null_code )
+            return QVariant();
+        return string(row);
+    }
+
+    bool setData(int row, const QVariant& value) override
+    {
+        if ( !value.isValid() )
+        {
+            codes_[row] = StringPool::null_code;
+            return true;
+        }
+        return setString(row, value.toString());
+    }
+
+    bool isNull(int row) const override
+    {
+        return codes_[row] == StringPool::null_code;
+    }
+
+    void insertRows(int row, int count) override
+    {
+        codes_.insert(codes_.begin() + row, count, Code(StringPool::null_code));
+    }
+
+    void removeRows(int row, int count) override
+    {
+        codes_.erase(codes_.begin() + row, codes_.begin() + row + count);
+    }
+
+    void moveRows(int row, int count, int to_row) override
+    {
+        detail::moveRange(codes_, row, count, to_row);
+    }
+
+private:
+    std::shared_ptr<StringPool> pool_;
+    std::vector<Code> codes_;
+};
+
+using DictionaryColumn8  = DictionaryColumn<quint8>;
+using DictionaryColumn16 = DictionaryColumn<quint16>;
+using DictionaryColumn32 = DictionaryColumn<quint32>;
+
+} // namespace imv
+#endif // IMV_DICTIONARY_COLUMN_HPP
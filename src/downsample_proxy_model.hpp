@@ -0,0 +1,645 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_DOWNSAMPLE_PROXY_MODEL_HPP
+#define IMV_DOWNSAMPLE_PROXY_MODEL_HPP
+
+#include <algorithm>
+#include <vector>
+#include "model.hpp"
+#include "column.hpp"
+
+namespace imv {
+
+/**
+ * \brief Reduces a numeric column of the top-level rows of a model for plotting
+ *
+ * The rows in the selected range are split into buckets, and for each
+ * bucket the proxy shows the rows with the minimum and maximum value,
+ * in source order. The first column is the x coordinate (a source column
+ * or the source row), the second one the value.
+ *
+ * The minimum and maximum are taken from a pyramid built over the source
+ * column: the first level has one entry for each block of rows, each
+ * following level merges pairs of entries of the one below. A bucket is
+ * made of the few entries covering its blocks, O(log n) of them, so
+ * changing the range or the resolution costs in proportion to the number
+ * of buckets. Only the partial blocks at the ends of the range and buckets
+ * narrower than a block are computed from the rows.
+ *
+ * dataChanged() updates one block and its ancestors, rows appended to the
+ * source extend the pyramid. rowsShifted() extends it as well, the blocks of
+ * the rows shifted out are left behind and dropped with a rebuild once they
+ * outnumber the remaining rows. Other structural changes rebuild it.
+ * Items which can't be converted to a number are ignored.
+ */
+class DownsampleProxyModel : public Model
+{
+public:
+    enum Column
+    {
+        XColumn,
+        YColumn,
+        ColumnCount
+    };
+
+    /**
+     * \param source        Model to reduce
+     * \param y_column      Source column with the values
+     * \param x_column      Source column with the x coordinates, -1 to use the row number
+     * \param buckets       Number of buckets the range is split into
+     * \param block_size    Number of source rows in the first pyramid level
+     */
+    explicit DownsampleProxyModel(Model* source = nullptr, int y_column = 0,
+                                  int x_column = -1, int buckets = 1000,
+                                  int block_size = 64)
+        : y_column_(y_column),
+          x_column_(x_column),
+          buckets_(std::max(buckets, 1)),
+          block_size_(std::max(block_size, 1))
+    {
+        setSourceModel(source);
+    }
+
+    Model* sourceModel() const
+    {
+        return source_;
+    }
+
+    void setSourceModel(Model* source)
+    {
+        if ( source_ )
+            QObject::disconnect(source_, nullptr, this, nullptr);
+
+        source_ = source;
+        if ( source_ )
+        {
+            connect(source_, &Model::dataChanged, this, &DownsampleProxyModel::onSourceDataChanged);
+            connect(source_, &Model::dataRangeChanged, this, &DownsampleProxyModel::onSourceDataRangeChanged);
+            connect(source_, &Model::rowsAdded, this, &DownsampleProxyModel::onSourceRowsAdded);
+            connect(source_, &Model::rowsRemoved, this, &DownsampleProxyModel::onSourceRowsRemoved);
+            connect(source_, &Model::rowsShifted, this, &DownsampleProxyModel::onSourceRowsShifted);
+            connect(source_, &Model::rowsMoved, this, &DownsampleProxyModel::onSourceRowsMoved);
+            connect(source_, &Model::columnsAdded, this, &DownsampleProxyModel::onSourceColumnsAdded);
+            connect(source_, &Model::columnsRemoved, this, &DownsampleProxyModel::onSourceColumnsRemoved);
+            connect(source_, &Model::columnsMoved, this, &DownsampleProxyModel::onSourceColumnsMoved);
+            connect(source_, &Model::modelReset, this, &DownsampleProxyModel::rebuild);
+            connect(source_, &Model::layoutChanged, this, &DownsampleProxyModel::onSourceLayoutChanged);
+        }
+        rebuild();
+    }
+
+    /**
+     * \brief Selects the source columns used for the values and the x coordinates
+     */
+    void setColumns(int y_column, int x_column = -1)
+    {
+        y_column_ = y_column;
+        x_column_ = x_column;
+        rebuild();
+    }
+
+    int yColumn() const
+    {
+        return y_column_;
+    }
+
+    int xColumn() const
+    {
+        return x_column_;
+    }
+
+    /**
+     * \brief Sets the number of buckets, each shows up to two rows
+     */
+    void setResolution(int buckets)
+    {
+        buckets_ = std::max(buckets, 1);
+        update();
+    }
+
+    int resolution() const
+    {
+        return buckets_;
+    }
+
+    /**
+     * \brief Reduces only the source rows in [first_row, first_row + row_count)
+     * \param first_row First source row
+     * \param row_count Number of rows, -1 to include the rows appended later
+     */
+    void setRange(int first_row, int row_count = -1)
+    {
+        first_row_ = std::max(first_row, 0);
+        row_count_ = row_count;
+        update();
+    }
+
+    /**
+     * \brief Source row shown at \p row
+     */
+    int mapToSource(int row) const
+    {
+        return row >= 0 && row < int(points_.size()) ? points_[row].row : -1;
+    }
+
+    /**
+     * \brief Number of levels in the pyramid
+     */
+    int levelCount() const
+    {
+        return levels_.size();
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : points_.size();
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : ColumnCount;
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < int(points_.size()) && index.column() < ColumnCount;
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        const Point& point = points_[index.row()];
+        if ( index.column() == YColumn )
+            return role == Value ? QVariant(point.value) : QVariant();
+        if ( x_column_ < 0 )
+            return role == Value ? QVariant(point.row) : QVariant();
+        return source_->data(source_->index(point.row, x_column_), role);
+    }
+
+private:
+    /**
+     * \brief Minimum and maximum of a range of rows
+     */
+    struct Extent
+    {
+        double min = 0;
+        double max = 0;
+        int min_row = -1;
+        int max_row = -1;
+
+        bool empty() const
+        {
+            return min_row < 0;
+        }
+
+        void add(double value, int row)
+        {
+            if ( empty() || value < min )
+            {
+                min = value;
+                min_row = row;
+            }
+            if ( max_row < 0 || value > max )
+            {
+                max = value;
+                max_row = row;
+            }
+        }
+
+        void merge(const Extent& other)
+        {
+            if ( other.empty() )
+                return;
+            if ( empty() || other.min < min )
+            {
+                min = other.min;
+                min_row = other.min_row;
+            }
+            if ( max_row < 0 || other.max > max )
+            {
+                max = other.max;
+                max_row = other.max_row;
+            }
+        }
+    };
+
+    struct Point
+    {
+        int row;
+        double value;
+    };
+
+    static bool toNumber(const QVariant& value, double& number)
+    {
+        if ( !value.isValid() )
+            return false;
+        bool ok = false;
+        number = value.toDouble(&ok);
+        return ok;
+    }
+
+    bool hasColumn() const
+    {
+        return source_ && y_column_ >= 0 && y_column_ < source_->columnCount();
+    }
+
+    /**
+     * \brief Minimum and maximum of the rows at the positions [pos, pos + count)
+     */
+    Extent readRows(int pos, int count) const
+    {
+        Extent extent;
+        QVector<QVariant> values = source_->dataRange(y_column_, pos - offset_, count);
+        for ( int i = 0; i < values.size(); i++ )
+        {
+            double number;
+            if ( toNumber(values[i], number) )
+                extent.add(number, pos + i);
+        }
+        return extent;
+    }
+
+    /**
+     * \brief Extent of the rows at the positions [begin, end)
+     *
+     * Whole blocks are taken from the pyramid, the partial blocks at either
+     * end are read from the source.
+     */
+    Extent extentOf(int begin, int end) const
+    {
+        int first_block = (begin + block_size_ - 1) / block_size_;
+        int last_block = end / block_size_;
+        if ( first_block >= last_block )
+            return readRows(begin, end - begin);
+
+        Extent extent;
+        if ( begin < first_block * block_size_ )
+            extent = readRows(begin, first_block * block_size_ - begin);
+        if ( end > last_block * block_size_ )
+            extent.merge(readRows(last_block * block_size_, end - last_block * block_size_));
+
+        // Climb the levels, taking the entries not covered by a parent
+        for ( std::size_t level = 0; first_block < last_block; level++ )
+        {
+            if ( first_block & 1 )
+                extent.merge(levels_[level][first_block++]);
+            if ( last_block & 1 )
+                extent.merge(levels_[level][--last_block]);
+            first_block /= 2;
+            last_block /= 2;
+        }
+        return extent;
+    }
+
+    Extent readBlock(int block) const
+    {
+        int begin = std::max(block * block_size_, offset_);
+        int end = std::min(block * block_size_ + block_size_, offset_ + rows_);
+        return end > begin ? readRows(begin, end - begin) : Extent();
+    }
+
+    /**
+     * \brief Recomputes the entries above the blocks in [first_block, last_block]
+     */
+    void updateLevels(int first_block, int last_block)
+    {
+        for ( std::size_t level = 1; level < levels_.size() || levels_[level - 1].size() > 1; level++ )
+        {
+            if ( level == levels_.size() )
+                levels_.emplace_back();
+            const std::vector<Extent>& below = levels_[level - 1];
+            std::vector<Extent>& current = levels_[level];
+            current.resize((below.size() + 1) / 2);
+
+            first_block /= 2;
+            last_block = std::min<int>(last_block / 2, current.size() - 1);
+            for ( int i = first_block; i <= last_block; i++ )
+            {
+                current[i] = below[2 * i];
+                if ( std::size_t(2 * i + 1) < below.size() )
+                    current[i].merge(below[2 * i + 1]);
+            }
+        }
+    }
+
+    /**
+     * \brief Reads the blocks from \p first_block to the end and updates the levels above
+     */
+    void extend(int first_block)
+    {
+        if ( levels_.empty() )
+            levels_.emplace_back();
+        std::vector<Extent>& blocks = levels_[0];
+        blocks.resize((offset_ + rows_ + block_size_ - 1) / block_size_);
+        for ( std::size_t i = first_block; i < blocks.size(); i++ )
+            blocks[i] = readBlock(i);
+        if ( !blocks.empty() )
+            updateLevels(first_block, blocks.size() - 1);
+    }
+
+    /**
+     * \brief Rebuilds the pyramid from the source
+     */
+    void rebuild()
+    {
+        levels_.clear();
+        offset_ = 0;
+        rows_ = hasColumn() ? source_->rowCount() : 0;
+        if ( rows_ > 0 )
+            extend(0);
+        update();
+    }
+
+    /**
+     * \brief Source rows currently reduced, as [first, last)
+     */
+    void range(int& first, int& last) const
+    {
+        first = std::min(first_row_, rows_);
+        last = row_count_ < 0 ? rows_ : std::min(rows_, first + row_count_);
+    }
+
+    void addPoints(std::vector<Point>& points, const Extent& extent) const
+    {
+        if ( extent.empty() )
+            return;
+        int first = std::min(extent.min_row, extent.max_row);
+        int last = std::max(extent.min_row, extent.max_row);
+        points.push_back(Point{first - offset_, first == extent.min_row ? extent.min : extent.max});
+        if ( last != first )
+            points.push_back(Point{last - offset_, last == extent.min_row ? extent.min : extent.max});
+    }
+
+    /**
+     * \brief Recomputes the buckets, emitting the change of the proxy rows
+     *
+     * The proxy is reset if the number of rows changes, the new points
+     * replace the old ones only after modelAboutToReset().
+     */
+    void update()
+    {
+        std::vector<Point> points;
+
+        int first, last;
+        range(first, last);
+        first += offset_;
+        last += offset_;
+        qint64 count = last - first;
+        if ( count > 0 )
+        {
+            if ( count < qint64(buckets_) * block_size_ )
+            {
+                // Narrow buckets, reading the rows costs less than a block each
+                for ( int i = 0; i < buckets_; i++ )
+                {
+                    int begin = first + count * i / buckets_;
+                    int end = first + count * (i + 1) / buckets_;
+                    if ( end > begin )
+                        addPoints(points, readRows(begin, end - begin));
+                }
+            }
+            else
+            {
+                // Buckets are at least a block wide, inner bounds are moved
+                // to block bounds so only the ends of the range read rows
+                int begin = first;
+                for ( int i = 1; i <= buckets_; i++ )
+                {
+                    int end = last;
+                    if ( i < buckets_ )
+                    {
+                        qint64 bound = first + count * i / buckets_;
+                        bound = (bound + block_size_ / 2) / block_size_ * block_size_;
+                        end = std::max<qint64>(begin, std::min<qint64>(bound, last));
+                    }
+                    if ( end > begin )
+                        addPoints(points, extentOf(begin, end));
+                    begin = end;
+                }
+            }
+        }
+
+        if ( points.size() != points_.size() )
+        {
+            beginReset();
+            points_.swap(points);
+            endReset();
+        }
+        else if ( !points.empty() )
+        {
+            points_.swap(points);
+            notifyDataRangeChanged(0, 0, points_.size(), ColumnCount, Index(), -1);
+        }
+    }
+
+    bool inRange(int row, int count) const
+    {
+        int first, last;
+        range(first, last);
+        return row < last && row + count > first;
+    }
+
+    /**
+     * \brief Updates the blocks containing the rows in [row, row + count)
+     */
+    void updateRows(int row, int count)
+    {
+        int first_block = (offset_ + row) / block_size_;
+        int last_block = (offset_ + row + count - 1) / block_size_;
+        for ( int block = first_block; block <= last_block; block++ )
+            levels_[0][block] = readBlock(block);
+        updateLevels(first_block, last_block);
+        if ( inRange(row, count) )
+            update();
+    }
+
+    void onSourceDataChanged(const Index& index, const QVariant& value, int role)
+    {
+        if ( role != Value || index.parent().valid() || levels_.empty() )
+            return;
+
+        if ( index.column() == x_column_ )
+        {
+            if ( inRange(index.row(), 1) )
+                update();
+            return;
+        }
+        if ( index.column() != y_column_ )
+            return;
+
+        int row = index.row();
+        int pos = offset_ + row;
+        Extent& block = levels_[0][pos / block_size_];
+        double number;
+        // The block needs to be read again only if the old value was an extreme
+        if ( pos != block.min_row && pos != block.max_row && toNumber(value, number) )
+        {
+            block.add(number, pos);
+            updateLevels(pos / block_size_, pos / block_size_);
+            if ( inRange(row, 1) )
+                update();
+        }
+        else
+        {
+            updateRows(row, 1);
+        }
+    }
+
+    void onSourceDataRangeChanged(int row, int column, int row_count, int column_count,
+                                  const Index& parent, int role)
+    {
+        if ( parent.valid() || (role != Value && role != -1) || levels_.empty() )
+            return;
+        if ( column <= y_column_ && column + column_count > y_column_ )
+            updateRows(row, row_count);
+        else if ( column <= x_column_ && column + column_count > x_column_ && inRange(row, row_count) )
+            update();
+    }
+
+    void onSourceRowsAdded(int row, int count, const Index& parent)
+    {
+        if ( parent.valid() || !hasColumn() )
+            return;
+        if ( row < rows_ )
+        {
+            rebuild();
+            return;
+        }
+
+        // Appended rows only change the last block and add new ones
+        rows_ += count;
+        extend(std::max(offset_ + row - 1, 0) / block_size_);
+        if ( inRange(row, count) )
+            update();
+    }
+
+    void onSourceRowsShifted(int removed, int added, const Index& parent)
+    {
+        if ( parent.valid() || !hasColumn() )
+            return;
+
+        int end = offset_ + rows_;
+        offset_ += removed;
+        rows_ += added - removed;
+        if ( offset_ > rows_ )
+        {
+            rebuild();
+            return;
+        }
+
+        extend(std::max(end - 1, 0) / block_size_);
+        // The block with the new first row may have lost its extremes
+        if ( rows_ > 0 && offset_ % block_size_ )
+        {
+            int block = offset_ / block_size_;
+            levels_[0][block] = readBlock(block);
+            updateLevels(block, block);
+        }
+        update();
+    }
+
+    void onSourceRowsRemoved(int row, int count, const Index& parent)
+    {
+        if ( !parent.valid() )
+            rebuild();
+    }
+
+    void onSourceRowsMoved(const Index& from_parent, int from_row, int count,
+                           const Index& to_parent, int to_row)
+    {
+        if ( !from_parent.valid() && !to_parent.valid() )
+            rebuild();
+    }
+
+    void onSourceLayoutChanged(const Index& parent, const QVector<int>& permutation)
+    {
+        if ( !parent.valid() )
+            rebuild();
+    }
+
+    void onSourceColumnsAdded(int column, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        if ( y_column_ >= column )
+            y_column_ += count;
+        if ( x_column_ >= column )
+            x_column_ += count;
+        if ( !hasColumn() || levels_.empty() )
+            rebuild();
+    }
+
+    void onSourceColumnsRemoved(int column, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+
+        auto removed = [=](int& col) {
+            if ( col < column )
+                return false;
+            if ( col < column + count )
+            {
+                col = -1;
+                return true;
+            }
+            col -= count;
+            return false;
+        };
+
+        bool rebuild_pyramid = removed(y_column_);
+        bool update_points = removed(x_column_);
+        if ( rebuild_pyramid )
+            rebuild();
+        else if ( update_points )
+            update();
+    }
+
+    void onSourceColumnsMoved(const Index& from_parent, int from_column, int count,
+                              const Index& to_parent, int to_column)
+    {
+        if ( from_parent.valid() || to_parent.valid() )
+            return;
+        if ( y_column_ >= 0 )
+            y_column_ = detail::movedIndex(y_column_, from_column, count, to_column);
+        if ( x_column_ >= 0 )
+            x_column_ = detail::movedIndex(x_column_, from_column, count, to_column);
+    }
+
+    Model* source_ = nullptr;
+    int y_column_;
+    int x_column_;
+    int buckets_;
+    int block_size_;
+    int first_row_ = 0;
+    int row_count_ = -1;
+
+    /// Source rows covered by the pyramid
+    int rows_ = 0;
+    /// Position of the first source row in the pyramid, the ones before have been shifted out
+    int offset_ = 0;
+    /// levels_[0] has an entry per block, each level above merges pairs,
+    /// the extents refer to positions rather than to source rows
+    std::vector<std::vector<Extent>> levels_;
+    std::vector<Point> points_;
+};
+
+} // namespace imv
+#endif // IMV_DOWNSAMPLE_PROXY_MODEL_HPP
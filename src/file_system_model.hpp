@@ -0,0 +1,605 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_FILE_SYSTEM_MODEL_HPP
+#define IMV_FILE_SYSTEM_MODEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include "model.hpp"
+
+namespace imv {
+
+/**
+ * \brief Tree model showing the contents of a directory
+ *
+ * Directories are scanned the first time their row count is requested,
+ * on a thread pool so several directories can be scanned at once and the
+ * caller never waits for the disk: the children appear with rowsAdded()
+ * when the scan is done.
+ *
+ * Loaded directories are watched for changes, changes arriving within
+ * the update delay are coalesced and the directory is scanned again.
+ * The new contents are compared with the current ones and the differences
+ * emitted as runs of rowsRemoved() and rowsAdded().
+ *
+ * Nodes are allocated from an arena and reused once removed, file names
+ * are interned so repeated names share their storage, and dropped when
+ * the last node using them is removed.
+ *
+ * \note The number of watched directories is limited by the system
+ *       (on Linux by fs.inotify.max_user_watches).
+ */
+class FileSystemModel : public Model
+{
+public:
+    enum Column
+    {
+        NameColumn,
+        SizeColumn,
+        ModifiedColumn,
+        ColumnCount
+    };
+
+    /**
+     * \param root_path Directory shown at the top level
+     * \param threads   Number of directories scanned at the same time
+     */
+    explicit FileSystemModel(const QString& root_path,
+                             int threads = QThread::idealThreadCount())
+    {
+        pool_.setMaxThreadCount(std::max(threads, 1));
+
+        root_ = allocate(nullptr, Entry{root_path, true, 0, 0});
+
+        update_timer_.setSingleShot(true);
+        update_timer_.setInterval(100);
+        connect(&update_timer_, &QTimer::timeout, this, &FileSystemModel::onUpdateTimeout);
+        connect(&watcher_, &QFileSystemWatcher::directoryChanged,
+                this, &FileSystemModel::onDirectoryChanged);
+    }
+
+    ~FileSystemModel()
+    {
+        cancelled_ = true;
+        pool_.clear();
+        pool_.waitForDone();
+    }
+
+    QString rootPath() const
+    {
+        return *root_->name;
+    }
+
+    /**
+     * \brief Path of the file at \p index, the root path for an invalid index
+     */
+    QString filePath(const Index& index) const
+    {
+        return filePath(node(index));
+    }
+
+    bool isDir(const Index& index) const
+    {
+        return node(index)->directory;
+    }
+
+    /**
+     * \brief Whether the children of \p parent have been scanned
+     */
+    bool isLoaded(const Index& parent = {}) const
+    {
+        return node(parent)->state == Loaded;
+    }
+
+    /**
+     * \brief Whether \p parent is being scanned
+     */
+    bool isLoading(const Index& parent = {}) const
+    {
+        return node(parent)->state == Loading;
+    }
+
+    /**
+     * \brief Scans \p parent again
+     */
+    void refresh(const Index& parent = {})
+    {
+        Node* dir = node(parent);
+        if ( dir->directory )
+            scan(dir);
+    }
+
+    /**
+     * \brief Milliseconds to wait for more changes before scanning a changed directory
+     */
+    void setUpdateDelay(int msec)
+    {
+        update_timer_.setInterval(std::max(msec, 0));
+    }
+
+    /**
+     * \brief Number of files and directories currently in memory
+     */
+    int nodeCount() const
+    {
+        return nodes_.size() - free_.size();
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        Node* dir = node(parent);
+        if ( !dir->directory )
+            return 0;
+        if ( dir->state == Unloaded )
+            const_cast<FileSystemModel*>(this)->scan(dir);
+        return dir->children.size();
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return ColumnCount;
+    }
+
+    Index onIndex(int row, int column, const Index& parent) const override
+    {
+        Node* dir = node(parent);
+        if ( row >= int(dir->children.size()) || column >= ColumnCount )
+            return {};
+        return createIndex(row, column, dir->children[row]);
+    }
+
+    Index onParent(const Index& index) const override
+    {
+        Node* child = index.internalPointer<Node>();
+        if ( !child || !child->parent || child->parent == root_ )
+            return {};
+        return createIndex(child->parent->row, 0, child->parent);
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        Node* child = index.internalPointer<Node>();
+        return child && child->parent && index.column() < ColumnCount &&
+               index.row() < int(child->parent->children.size()) &&
+               child->parent->children[index.row()] == child;
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return QVariant();
+
+        Node* file = index.internalPointer<Node>();
+        switch ( index.column() )
+        {
+            case NameColumn:
+                return *file->name;
+            case SizeColumn:
+                return file->directory ? QVariant() : QVariant(file->size);
+            case ModifiedColumn:
+                return QDateTime::fromMSecsSinceEpoch(file->modified);
+        }
+        return QVariant();
+    }
+
+private:
+    enum State
+    {
+        Unloaded,
+        Loading,
+        Loaded
+    };
+
+    struct Node
+    {
+        Node* parent = nullptr;
+        const QString* name = nullptr;
+        std::vector<Node*> children;
+        qint64 size = 0;
+        qint64 modified = 0;
+        /// Row in parent->children
+        int row = 0;
+        /// Incremented when the node is released, to discard stale scans
+        quint32 generation = 0;
+        bool directory = false;
+        State state = Unloaded;
+        /// Changed while being scanned
+        bool rescan = false;
+    };
+
+    /**
+     * \brief Directory entry read by a scan
+     */
+    struct Entry
+    {
+        QString name;
+        bool directory;
+        qint64 size;
+        qint64 modified;
+    };
+
+    struct ScanResult
+    {
+        Node* node;
+        quint32 generation;
+        std::vector<Entry> entries;
+    };
+
+    class ScanTask : public QRunnable
+    {
+    public:
+        explicit ScanTask(std::function<void()> function)
+            : function_(std::move(function))
+        {}
+
+        void run() override
+        {
+            function_();
+        }
+
+    private:
+        std::function<void()> function_;
+    };
+
+    struct NameHash
+    {
+        std::size_t operator()(const QString& name) const
+        {
+            return qHash(name);
+        }
+    };
+
+    /**
+     * \brief Order of the children: directories first, then by name
+     */
+    static bool before(bool directory, const QString& name, const Node* node)
+    {
+        if ( directory != node->directory )
+            return directory;
+        return name < *node->name;
+    }
+
+    static bool before(const Entry& a, const Entry& b)
+    {
+        if ( a.directory != b.directory )
+            return a.directory;
+        return a.name < b.name;
+    }
+
+    /**
+     * \brief Reads the entries of \p path, runs in the thread pool
+     */
+    static std::vector<Entry> readDirectory(const QString& path, const std::atomic<bool>& cancelled)
+    {
+        std::vector<Entry> entries;
+        QDirIterator iter(path, QDir::AllEntries | QDir::NoDotAndDotDot |
+                                QDir::Hidden | QDir::System);
+        while ( iter.hasNext() && !cancelled )
+        {
+            iter.next();
+            QFileInfo info = iter.fileInfo();
+            entries.push_back(Entry{
+                info.fileName(),
+                info.isDir() && !info.isSymLink(),
+                info.size(),
+                info.lastModified().toMSecsSinceEpoch()
+            });
+        }
+        std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return before(a, b); });
+        return entries;
+    }
+
+    Node* node(const Index& index) const
+    {
+        if ( index.model() == this && index.internalId() )
+            return index.internalPointer<Node>();
+        return root_;
+    }
+
+    Index nodeIndex(Node* node) const
+    {
+        if ( node == root_ )
+            return {};
+        return createIndex(node->row, 0, node);
+    }
+
+    QString filePath(const Node* node) const
+    {
+        if ( node == root_ )
+            return *node->name;
+        QString parent = filePath(node->parent);
+        if ( !parent.endsWith('/') )
+            parent += '/';
+        return parent + *node->name;
+    }
+
+    /**
+     * \brief Shared copy of \p name, to be given back with releaseName()
+     */
+    const QString* intern(const QString& name)
+    {
+        auto iter = names_.emplace(name, 0).first;
+        iter->second++;
+        return &iter->first;
+    }
+
+    void releaseName(const QString* name)
+    {
+        auto iter = names_.find(*name);
+        if ( iter != names_.end() && --iter->second == 0 )
+            names_.erase(iter);
+    }
+
+    Node* allocate(Node* parent, const Entry& entry)
+    {
+        Node* node;
+        if ( !free_.empty() )
+        {
+            node = free_.back();
+            free_.pop_back();
+        }
+        else
+        {
+            nodes_.emplace_back();
+            node = &nodes_.back();
+        }
+
+        node->parent = parent;
+        node->name = intern(entry.name);
+        node->size = entry.size;
+        node->modified = entry.modified;
+        node->directory = entry.directory;
+        node->state = Unloaded;
+        node->rescan = false;
+        return node;
+    }
+
+    /**
+     * \brief Returns \p node and its descendants to the arena
+     */
+    void release(Node* node)
+    {
+        for ( Node* child : node->children )
+            release(child);
+
+        if ( node->state != Unloaded )
+        {
+            QString path = filePath(node);
+            watcher_.removePath(path);
+            watched_.remove(path);
+            dirty_.remove(path);
+        }
+
+        releaseName(node->name);
+        node->name = nullptr;
+        node->generation++;
+        node->children.clear();
+        node->children.shrink_to_fit();
+        free_.push_back(node);
+    }
+
+    void renumber(Node* dir, int from)
+    {
+        for ( int i = from; i < int(dir->children.size()); i++ )
+            dir->children[i]->row = i;
+    }
+
+    /**
+     * \brief Queues a scan of \p dir on the thread pool
+     */
+    void scan(Node* dir)
+    {
+        if ( dir->state == Loading )
+        {
+            dir->rescan = true;
+            return;
+        }
+
+        bool first = dir->state == Unloaded;
+        dir->state = Loading;
+        QString path = filePath(dir);
+        if ( first )
+        {
+            watcher_.addPath(path);
+            watched_.insert(path, dir);
+        }
+
+        quint32 generation = dir->generation;
+        pool_.start(new ScanTask([this, dir, generation, path]() {
+            ScanResult result{dir, generation, readDirectory(path, cancelled_)};
+            if ( cancelled_ )
+                return;
+            {
+                std::lock_guard<std::mutex> lock(results_mutex_);
+                results_.push_back(std::move(result));
+            }
+            QMetaObject::invokeMethod(this, [this]{ applyResults(); }, Qt::QueuedConnection);
+        }));
+    }
+
+    /**
+     * \brief Applies the finished scans, in the thread owning the model
+     */
+    void applyResults()
+    {
+        std::vector<ScanResult> results;
+        {
+            std::lock_guard<std::mutex> lock(results_mutex_);
+            results.swap(results_);
+        }
+
+        for ( ScanResult& result : results )
+        {
+            Node* dir = result.node;
+            // The directory has been removed while being scanned
+            if ( dir->generation != result.generation )
+                continue;
+
+            dir->state = Loaded;
+            update(dir, result.entries);
+            if ( dir->rescan )
+            {
+                dir->rescan = false;
+                scan(dir);
+            }
+        }
+    }
+
+    /**
+     * \brief Replaces the children of \p dir with \p entries, emitting the differences
+     */
+    void update(Node* dir, const std::vector<Entry>& entries)
+    {
+        Index parent = nodeIndex(dir);
+        std::vector<Node*>& children = dir->children;
+        std::vector<char> matched(entries.size(), 0);
+        std::vector<char> keep(children.size(), 0);
+        std::vector<Node*> changed;
+
+        // Both are sorted the same way, so they can be merged
+        std::size_t j = 0;
+        for ( std::size_t i = 0; i < children.size(); i++ )
+        {
+            Node* child = children[i];
+            while ( j < entries.size() && before(entries[j].directory, entries[j].name, child) )
+                j++;
+            if ( j < entries.size() && entries[j].directory == child->directory &&
+                 entries[j].name == *child->name )
+            {
+                keep[i] = matched[j] = 1;
+                if ( child->size != entries[j].size || child->modified != entries[j].modified )
+                {
+                    child->size = entries[j].size;
+                    child->modified = entries[j].modified;
+                    changed.push_back(child);
+                }
+                j++;
+            }
+        }
+
+        // Removed runs, from the end so the earlier rows don't shift
+        for ( int i = int(children.size()) - 1; i >= 0; )
+        {
+            if ( keep[i] )
+            {
+                i--;
+                continue;
+            }
+            int last = i;
+            while ( i >= 0 && !keep[i] )
+                i--;
+            int first = i + 1;
+            for ( int k = first; k <= last; k++ )
+                release(children[k]);
+            children.erase(children.begin() + first, children.begin() + last + 1);
+            renumber(dir, first);
+            notifyRowsRemoved(first, last - first + 1, parent);
+        }
+
+        // Added runs, the kept children are in the same order as their entries
+        int row = 0;
+        for ( std::size_t i = 0; i < entries.size(); )
+        {
+            if ( matched[i] )
+            {
+                row++;
+                i++;
+                continue;
+            }
+            std::vector<Node*> added;
+            for ( ; i < entries.size() && !matched[i]; i++ )
+                added.push_back(allocate(dir, entries[i]));
+            children.insert(children.begin() + row, added.begin(), added.end());
+            renumber(dir, row);
+            notifyRowsAdded(row, added.size(), parent);
+            row += added.size();
+        }
+
+        if ( !changed.empty() )
+        {
+            auto range = std::minmax_element(changed.begin(), changed.end(),
+                [](Node* a, Node* b) { return a->row < b->row; });
+            int first = (*range.first)->row;
+            int last = (*range.second)->row;
+            notifyDataRangeChanged(first, SizeColumn, last - first + 1,
+                                  ModifiedColumn - SizeColumn + 1, parent, Value);
+        }
+    }
+
+    void onDirectoryChanged(const QString& path)
+    {
+        if ( watched_.contains(path) )
+        {
+            dirty_.insert(path);
+            if ( !update_timer_.isActive() )
+                update_timer_.start();
+        }
+    }
+
+    void onUpdateTimeout()
+    {
+        QSet<QString> dirty;
+        dirty.swap(dirty_);
+        for ( const QString& path : dirty )
+        {
+            if ( Node* dir = watched_.value(path) )
+                scan(dir);
+        }
+    }
+
+    /// Node arena, deque keeps the addresses stable
+    std::deque<Node> nodes_;
+    std::vector<Node*> free_;
+    /// Interned names and how many nodes use each
+    std::unordered_map<QString, int, NameHash> names_;
+    Node* root_;
+
+    QThreadPool pool_;
+    std::atomic<bool> cancelled_{false};
+    std::mutex results_mutex_;
+    std::vector<ScanResult> results_;
+
+    QFileSystemWatcher watcher_;
+    QHash<QString, Node*> watched_;
+    QSet<QString> dirty_;
+    QTimer update_timer_;
+};
+
+} // namespace imv
+#endif // IMV_FILE_SYSTEM_MODEL_HPP
@@ -0,0 +1,678 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_FILTER_KERNELS_HPP
+#define IMV_FILTER_KERNELS_HPP
+
+#include <vector>
+#include "bitmap.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define IMV_SIMD_X86
+#   include <immintrin.h>
+#   define IMV_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace imv {
+
+/**
+ * \brief Comparison performed by a filter
+ */
+enum CompareOp
+{
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+};
+
+/**
+ * \brief Predicates evaluated over arrays of values into a selection Bitmap
+ *
+ * \c float, \c double, \c qint32 and \c qint64 use SIMD instructions when
+ * the CPU supports them, other types are evaluated one value at a time.
+ */
+namespace kernels {
+
+/**
+ * \brief Instruction sets the kernels can use
+ */
+enum InstructionSet
+{
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512,
+};
+
+namespace detail {
+
+inline InstructionSet detectInstructionSet()
+{
+#ifdef IMV_SIMD_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx512f") )
+        return Avx512;
+    if ( __builtin_cpu_supports("avx2") )
+        return Avx2;
+    if ( __builtin_cpu_supports("sse2") )
+        return Sse2;
+#endif
+    return Scalar;
+}
+
+inline InstructionSet& currentInstructionSet()
+{
+    static InstructionSet set = detectInstructionSet();
+    return set;
+}
+
+template<int Op, class T>
+    inline bool compare(const T& a, const T& b)
+    {
+        switch ( Op )
+        {
+            case Equal:         return a == b;
+            case NotEqual:      return a != b;
+            case Less:          return a < b;
+            case LessEqual:     return a <= b;
+            case Greater:       return a > b;
+            case GreaterEqual:  return a >= b;
+        }
+        return false;
+    }
+
+/**
+ * \brief Combines integer comparison masks into the result for \p Op
+ */
+template<int Op>
+    inline unsigned selectMask(unsigned eq, unsigned lt, unsigned gt, unsigned full)
+    {
+        switch ( Op )
+        {
+            case Equal:         return eq;
+            case NotEqual:      return ~eq & full;
+            case Less:          return lt;
+            case LessEqual:     return ~gt & full;
+            case Greater:       return gt;
+            case GreaterEqual:  return ~lt & full;
+        }
+        return 0;
+    }
+
+/**
+ * \brief Scalar evaluation of the values from \p begin to \p count
+ *
+ * \p begin must be a multiple of 64.
+ */
+template<class T, class Predicate>
+    void evaluateScalar(const T* values, int begin, int count,
+                        quint64* words, const Predicate& predicate)
+    {
+        for ( int i = begin; i < count; i += 64 )
+        {
+            quint64 word = 0;
+            int end = std::min(count - i, 64);
+            for ( int j = 0; j < end; j++ )
+                word |= quint64(predicate(values[i + j])) << j;
+            words[i / 64] = word;
+        }
+    }
+
+template<class T, int Op>
+    struct ComparePredicate
+    {
+        T operand;
+        bool operator()(const T& value) const
+        {
+            return compare<Op>(value, operand);
+        }
+    };
+
+template<class T>
+    struct BetweenPredicate
+    {
+        T low;
+        T high;
+        bool operator()(const T& value) const
+        {
+            return low <= value && value <= high;
+        }
+    };
+
+template<class T>
+    struct InSetPredicate
+    {
+        const std::vector<T>& set;
+        bool operator()(const T& value) const
+        {
+            for ( const T& item : set )
+                if ( value == item )
+                    return true;
+            return false;
+        }
+    };
+
+#ifdef IMV_SIMD_X86
+
+/**
+ * \brief Vector operations for values of type \p T using \p Isa
+ *
+ * Specializations define \c vec, \c width, load(), set1() and cmp<Op>(),
+ * which returns one bit per lane.
+ */
+template<class Isa, class T>
+    struct SimdOps
+    {
+        enum { supported = false };
+    };
+
+/**
+ * \brief Defines a tag type with the kernels for an instruction set
+ *
+ * Each kernel processes the values in groups of 64, the remainder
+ * is left to the scalar code.
+ */
+#define IMV_SIMD_KERNELS(Isa, target)                                          \
+struct Isa                                                                     \
+{                                                                              \
+    template<class T, int Op>                                                  \
+    IMV_TARGET(target) static void compare(const T* values, int count,         \
+                                           T operand, quint64* words)          \
+    {                                                                          \
+        typedef SimdOps<Isa, T> Ops;                                           \
+        typename Ops::vec rhs = Ops::set1(operand);                            \
+        for ( int i = 0; i + 64 <= count; i += 64 )                            \
+        {                                                                      \
+            quint64 word = 0;                                                  \
+            for ( int j = 0; j < 64; j += Ops::width )                         \
+                word |= quint64(Ops::template cmp<Op>(                         \
+                    Ops::load(values + i + j), rhs)) << j;                     \
+            words[i / 64] = word;                                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    template<class T>                                                          \
+    IMV_TARGET(target) static void between(const T* values, int count,         \
+                                           T low, T high, quint64* words)      \
+    {                                                                          \
+        typedef SimdOps<Isa, T> Ops;                                           \
+        typename Ops::vec vlow = Ops::set1(low);                               \
+        typename Ops::vec vhigh = Ops::set1(high);                             \
+        for ( int i = 0; i + 64 <= count; i += 64 )                            \
+        {                                                                      \
+            quint64 word = 0;                                                  \
+            for ( int j = 0; j < 64; j += Ops::width )                         \
+            {                                                                  \
+                typename Ops::vec value = Ops::load(values + i + j);           \
+                unsigned mask = Ops::template cmp<GreaterEqual>(value, vlow) & \
+                                Ops::template cmp<LessEqual>(value, vhigh);    \
+                word |= quint64(mask) << j;                                    \
+            }                                                                  \
+            words[i / 64] = word;                                              \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    template<class T>                                                          \
+    IMV_TARGET(target) static void inSet(const T* values, int count,           \
+                                         const std::vector<T>& set,            \
+                                         quint64* words)                       \
+    {                                                                          \
+        typedef SimdOps<Isa, T> Ops;                                           \
+        for ( int i = 0; i + 64 <= count; i += 64 )                            \
+        {                                                                      \
+            quint64 word = 0;                                                  \
+            for ( int j = 0; j < 64; j += Ops::width )                         \
+            {                                                                  \
+                typename Ops::vec value = Ops::load(values + i + j);           \
+                unsigned mask = 0;                                             \
+                for ( const T& item : set )                                    \
+                    mask |= Ops::template cmp<Equal>(value, Ops::set1(item));  \
+                word |= quint64(mask) << j;                                    \
+            }                                                                  \
+            words[i / 64] = word;                                              \
+        }                                                                      \
+    }                                                                          \
+};
+
+IMV_SIMD_KERNELS(Sse2Kernels, "sse2")
+IMV_SIMD_KERNELS(Avx2Kernels, "avx2")
+IMV_SIMD_KERNELS(Avx512Kernels, "avx512f")
+
+#undef IMV_SIMD_KERNELS
+
+template<>
+    struct SimdOps<Sse2Kernels, float>
+    {
+        enum { supported = true, width = 4 };
+        typedef __m128 vec;
+        IMV_TARGET("sse2") static vec load(const float* p) { return _mm_loadu_ps(p); }
+        IMV_TARGET("sse2") static vec set1(float v) { return _mm_set1_ps(v); }
+        template<int Op>
+        IMV_TARGET("sse2") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm_movemask_ps(_mm_cmpeq_ps(a, b));
+                case NotEqual:      return _mm_movemask_ps(_mm_cmpneq_ps(a, b));
+                case Less:          return _mm_movemask_ps(_mm_cmplt_ps(a, b));
+                case LessEqual:     return _mm_movemask_ps(_mm_cmple_ps(a, b));
+                case Greater:       return _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+                case GreaterEqual:  return _mm_movemask_ps(_mm_cmpge_ps(a, b));
+            }
+            return 0;
+        }
+    };
+
+template<>
+    struct SimdOps<Sse2Kernels, double>
+    {
+        enum { supported = true, width = 2 };
+        typedef __m128d vec;
+        IMV_TARGET("sse2") static vec load(const double* p) { return _mm_loadu_pd(p); }
+        IMV_TARGET("sse2") static vec set1(double v) { return _mm_set1_pd(v); }
+        template<int Op>
+        IMV_TARGET("sse2") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm_movemask_pd(_mm_cmpeq_pd(a, b));
+                case NotEqual:      return _mm_movemask_pd(_mm_cmpneq_pd(a, b));
+                case Less:          return _mm_movemask_pd(_mm_cmplt_pd(a, b));
+                case LessEqual:     return _mm_movemask_pd(_mm_cmple_pd(a, b));
+                case Greater:       return _mm_movemask_pd(_mm_cmpgt_pd(a, b));
+                case GreaterEqual:  return _mm_movemask_pd(_mm_cmpge_pd(a, b));
+            }
+            return 0;
+        }
+    };
+
+template<>
+    struct SimdOps<Sse2Kernels, qint32>
+    {
+        enum { supported = true, width = 4 };
+        typedef __m128i vec;
+        IMV_TARGET("sse2") static vec load(const qint32* p) { return _mm_loadu_si128(reinterpret_cast<const vec*>(p)); }
+        IMV_TARGET("sse2") static vec set1(qint32 v) { return _mm_set1_epi32(v); }
+        IMV_TARGET("sse2") static unsigned mask(vec v) { return _mm_movemask_ps(_mm_castsi128_ps(v)); }
+        template<int Op>
+        IMV_TARGET("sse2") static unsigned cmp(vec a, vec b)
+        {
+            return selectMask<Op>(mask(_mm_cmpeq_epi32(a, b)), mask(_mm_cmplt_epi32(a, b)),
+                                  mask(_mm_cmpgt_epi32(a, b)), 0xf);
+        }
+    };
+
+template<>
+    struct SimdOps<Avx2Kernels, float>
+    {
+        enum { supported = true, width = 8 };
+        typedef __m256 vec;
+        IMV_TARGET("avx2") static vec load(const float* p) { return _mm256_loadu_ps(p); }
+        IMV_TARGET("avx2") static vec set1(float v) { return _mm256_set1_ps(v); }
+        template<int Op>
+        IMV_TARGET("avx2") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+                case NotEqual:      return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_NEQ_UQ));
+                case Less:          return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ));
+                case LessEqual:     return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ));
+                case Greater:       return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+                case GreaterEqual:  return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ));
+            }
+            return 0;
+        }
+    };
+
+template<>
+    struct SimdOps<Avx2Kernels, double>
+    {
+        enum { supported = true, width = 4 };
+        typedef __m256d vec;
+        IMV_TARGET("avx2") static vec load(const double* p) { return _mm256_loadu_pd(p); }
+        IMV_TARGET("avx2") static vec set1(double v) { return _mm256_set1_pd(v); }
+        template<int Op>
+        IMV_TARGET("avx2") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ));
+                case NotEqual:      return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_NEQ_UQ));
+                case Less:          return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ));
+                case LessEqual:     return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ));
+                case Greater:       return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ));
+                case GreaterEqual:  return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ));
+            }
+            return 0;
+        }
+    };
+
+template<>
+    struct SimdOps<Avx2Kernels, qint32>
+    {
+        enum { supported = true, width = 8 };
+        typedef __m256i vec;
+        IMV_TARGET("avx2") static vec load(const qint32* p) { return _mm256_loadu_si256(reinterpret_cast<const vec*>(p)); }
+        IMV_TARGET("avx2") static vec set1(qint32 v) { return _mm256_set1_epi32(v); }
+        IMV_TARGET("avx2") static unsigned mask(vec v) { return _mm256_movemask_ps(_mm256_castsi256_ps(v)); }
+        template<int Op>
+        IMV_TARGET("avx2") static unsigned cmp(vec a, vec b)
+        {
+            return selectMask<Op>(mask(_mm256_cmpeq_epi32(a, b)), mask(_mm256_cmpgt_epi32(b, a)),
+                                  mask(_mm256_cmpgt_epi32(a, b)), 0xff);
+        }
+    };
+
+template<>
+    struct SimdOps<Avx2Kernels, qint64>
+    {
+        enum { supported = true, width = 4 };
+        typedef __m256i vec;
+        IMV_TARGET("avx2") static vec load(const qint64* p) { return _mm256_loadu_si256(reinterpret_cast<const vec*>(p)); }
+        IMV_TARGET("avx2") static vec set1(qint64 v) { return _mm256_set1_epi64x(v); }
+        IMV_TARGET("avx2") static unsigned mask(vec v) { return _mm256_movemask_pd(_mm256_castsi256_pd(v)); }
+        template<int Op>
+        IMV_TARGET("avx2") static unsigned cmp(vec a, vec b)
+        {
+            return selectMask<Op>(mask(_mm256_cmpeq_epi64(a, b)), mask(_mm256_cmpgt_epi64(b, a)),
+                                  mask(_mm256_cmpgt_epi64(a, b)), 0xf);
+        }
+    };
+
+template<>
+    struct SimdOps<Avx512Kernels, float>
+    {
+        enum { supported = true, width = 16 };
+        typedef __m512 vec;
+        IMV_TARGET("avx512f") static vec load(const float* p) { return _mm512_loadu_ps(p); }
+        IMV_TARGET("avx512f") static vec set1(float v) { return _mm512_set1_ps(v); }
+        template<int Op>
+        IMV_TARGET("avx512f") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ);
+                case NotEqual:      return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ);
+                case Less:          return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+                case LessEqual:     return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ);
+                case Greater:       return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+                case GreaterEqual:  return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ);
+            }
+            return 0;
+        }
+    };
+
+template<>
+    struct SimdOps<Avx512Kernels, double>
+    {
+        enum { supported = true, width = 8 };
+        typedef __m512d vec;
+        IMV_TARGET("avx512f") static vec load(const double* p) { return _mm512_loadu_pd(p); }
+        IMV_TARGET("avx512f") static vec set1(double v) { return _mm512_set1_pd(v); }
+        template<int Op>
+        IMV_TARGET("avx512f") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ);
+                case NotEqual:      return _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ);
+                case Less:          return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+                case LessEqual:     return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ);
+                case Greater:       return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+                case GreaterEqual:  return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ);
+            }
+            return 0;
+        }
+    };
+
+template<>
+    struct SimdOps<Avx512Kernels, qint32>
+    {
+        enum { supported = true, width = 16 };
+        typedef __m512i vec;
+        IMV_TARGET("avx512f") static vec load(const qint32* p) { return _mm512_loadu_si512(p); }
+        IMV_TARGET("avx512f") static vec set1(qint32 v) { return _mm512_set1_epi32(v); }
+        template<int Op>
+        IMV_TARGET("avx512f") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_EQ);
+                case NotEqual:      return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NE);
+                case Less:          return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_LT);
+                case LessEqual:     return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_LE);
+                case Greater:       return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NLE);
+                case GreaterEqual:  return _mm512_cmp_epi32_mask(a, b, _MM_CMPINT_NLT);
+            }
+            return 0;
+        }
+    };
+
+template<>
+    struct SimdOps<Avx512Kernels, qint64>
+    {
+        enum { supported = true, width = 8 };
+        typedef __m512i vec;
+        IMV_TARGET("avx512f") static vec load(const qint64* p) { return _mm512_loadu_si512(p); }
+        IMV_TARGET("avx512f") static vec set1(qint64 v) { return _mm512_set1_epi64(v); }
+        template<int Op>
+        IMV_TARGET("avx512f") static unsigned cmp(vec a, vec b)
+        {
+            switch ( Op )
+            {
+                case Equal:         return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_EQ);
+                case NotEqual:      return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_NE);
+                case Less:          return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_LT);
+                case LessEqual:     return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_LE);
+                case Greater:       return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_NLE);
+                case GreaterEqual:  return _mm512_cmp_epi64_mask(a, b, _MM_CMPINT_NLT);
+            }
+            return 0;
+        }
+    };
+
+/**
+ * \brief Calls the kernels of \p Isa if they support \p T
+ * \returns \b false if \p T isn't supported
+ */
+template<class Isa, class T, bool = SimdOps<Isa, T>::supported>
+    struct Dispatch
+    {
+        template<int Op>
+        static bool compare(const T*, int, const T&, quint64*) { return false; }
+        static bool between(const T*, int, const T&, const T&, quint64*) { return false; }
+        static bool inSet(const T*, int, const std::vector<T>&, quint64*) { return false; }
+    };
+
+template<class Isa, class T>
+    struct Dispatch<Isa, T, true>
+    {
+        template<int Op>
+        static bool compare(const T* values, int count, const T& operand, quint64* words)
+        {
+            Isa::template compare<T, Op>(values, count, operand, words);
+            return true;
+        }
+
+        static bool between(const T* values, int count, const T& low, const T& high, quint64* words)
+        {
+            Isa::template between<T>(values, count, low, high, words);
+            return true;
+        }
+
+        static bool inSet(const T* values, int count, const std::vector<T>& set, quint64* words)
+        {
+            Isa::template inSet<T>(values, count, set, words);
+            return true;
+        }
+    };
+
+#define IMV_SIMD_DISPATCH(call)                                                 \
+    switch ( currentInstructionSet() )                                          \
+    {                                                                           \
+        case Avx512:                                                            \
+            if ( Dispatch<Avx512Kernels, T>::call )                             \
+                return count / 64 * 64;                                         \
+            /* fall through */                                                  \
+        case Avx2:                                                              \
+            if ( Dispatch<Avx2Kernels, T>::call )                               \
+                return count / 64 * 64;                                         \
+            /* fall through */                                                  \
+        case Sse2:                                                              \
+            if ( Dispatch<Sse2Kernels, T>::call )                               \
+                return count / 64 * 64;                                         \
+            /* fall through */                                                  \
+        case Scalar:                                                            \
+            break;                                                              \
+    }                                                                           \
+    return 0;
+
+#endif // IMV_SIMD_X86
+
+/**
+ * \brief Runs the best available SIMD kernel
+ * \returns The number of values processed
+ */
+template<int Op, class T>
+    int simdCompare(const T* values, int count, const T& operand, quint64* words)
+    {
+#ifdef IMV_SIMD_X86
+        IMV_SIMD_DISPATCH(template compare<Op>(values, count, operand, words))
+#else
+        return 0;
+#endif
+    }
+
+template<class T>
+    int simdBetween(const T* values, int count, const T& low, const T& high, quint64* words)
+    {
+#ifdef IMV_SIMD_X86
+        IMV_SIMD_DISPATCH(between(values, count, low, high, words))
+#else
+        return 0;
+#endif
+    }
+
+template<class T>
+    int simdInSet(const T* values, int count, const std::vector<T>& set, quint64* words)
+    {
+#ifdef IMV_SIMD_X86
+        IMV_SIMD_DISPATCH(inSet(values, count, set, words))
+#else
+        return 0;
+#endif
+    }
+
+#undef IMV_SIMD_DISPATCH
+
+template<int Op, class T>
+    void compare(const T* values, int count, const T& operand, quint64* words)
+    {
+        int done = simdCompare<Op>(values, count, operand, words);
+        evaluateScalar(values, done, count, words, ComparePredicate<T, Op>{operand});
+    }
+
+} // namespace detail
+
+/**
+ * \brief Instruction set used by the kernels
+ */
+inline InstructionSet instructionSet()
+{
+    return detail::currentInstructionSet();
+}
+
+/**
+ * \brief Limits the kernels to \p set, if the CPU supports it
+ * \returns The instruction set that will be used
+ */
+inline InstructionSet setInstructionSet(InstructionSet set)
+{
+    detail::currentInstructionSet() = std::min(set, detail::detectInstructionSet());
+    return detail::currentInstructionSet();
+}
+
+/**
+ * \brief Selects values for which <tt>value op operand</tt> holds
+ */
+template<class T>
+    Bitmap compare(const T* values, int count, CompareOp op, const T& operand)
+    {
+        Bitmap result(count);
+        quint64* words = result.data();
+        switch ( op )
+        {
+            case Equal:         detail::compare<Equal>(values, count, operand, words); break;
+            case NotEqual:      detail::compare<NotEqual>(values, count, operand, words); break;
+            case Less:          detail::compare<Less>(values, count, operand, words); break;
+            case LessEqual:     detail::compare<LessEqual>(values, count, operand, words); break;
+            case Greater:       detail::compare<Greater>(values, count, operand, words); break;
+            case GreaterEqual:  detail::compare<GreaterEqual>(values, count, operand, words); break;
+        }
+        return result;
+    }
+
+/**
+ * \brief Selects values between \p low and \p high (inclusive)
+ */
+template<class T>
+    Bitmap between(const T* values, int count, const T& low, const T& high)
+    {
+        Bitmap result(count);
+        int done = detail::simdBetween(values, count, low, high, result.data());
+        detail::evaluateScalar(values, done, count, result.data(),
+                               detail::BetweenPredicate<T>{low, high});
+        return result;
+    }
+
+/**
+ * \brief Selects values equal to any element of \p set
+ */
+template<class T>
+    Bitmap inSet(const T* values, int count, const std::vector<T>& set)
+    {
+        Bitmap result(count);
+        int done = detail::simdInSet(values, count, set, result.data());
+        detail::evaluateScalar(values, done, count, result.data(),
+                               detail::InSetPredicate<T>{set});
+        return result;
+    }
+
+/**
+ * \brief Selects null values given the bitmap of valid ones
+ */
+inline Bitmap isNull(const Bitmap& validity)
+{
+    Bitmap result = validity;
+    result.flip();
+    return result;
+}
+
+} // namespace kernels
+} // namespace imv
+
+#undef IMV_TARGET
+#undef IMV_SIMD_X86
+
+#endif // IMV_FILTER_KERNELS_HPP
@@ -0,0 +1,312 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_FILTER_PROXY_MODEL_HPP
+#define IMV_FILTER_PROXY_MODEL_HPP
+
+#include <algorithm>
+#include <vector>
+#include "model.hpp"
+#include "bitmap.hpp"
+
+namespace imv {
+
+/**
+ * \brief Shows the top-level rows of a source model selected by a Bitmap
+ *
+ * The selection is usually the result of the filter kernels or of
+ * TypedColumn::select(). Rows added to the source after the filter
+ * has been set are hidden until a new filter is set.
+ */
+class FilterProxyModel : public Model
+{
+public:
+    explicit FilterProxyModel(Model* source = nullptr)
+    {
+        setSourceModel(source);
+    }
+
+    /**
+     * \brief Model being filtered
+     */
+    Model* sourceModel() const
+    {
+        return source_;
+    }
+
+    /**
+     * \brief Sets the model to filter, all its rows are shown
+     */
+    void setSourceModel(Model* source)
+    {
+        if ( source_ )
+            QObject::disconnect(source_, nullptr, this, nullptr);
+
+        source_ = source;
+        if ( source_ )
+        {
+            connect(source_, &Model::dataChanged, this, &FilterProxyModel::onSourceDataChanged);
+            connect(source_, &Model::dataRangeChanged, this, &FilterProxyModel::onSourceDataRangeChanged);
+            connect(source_, &Model::rowsAdded, this, &FilterProxyModel::onSourceRowsAdded);
+            connect(source_, &Model::rowsRemoved, this, &FilterProxyModel::onSourceRowsRemoved);
+            connect(source_, &Model::rowsShifted, this, &FilterProxyModel::onSourceRowsShifted);
+            connect(source_, &Model::rowsMoved, this, &FilterProxyModel::onSourceRowsMoved);
+            connect(source_, &Model::columnsAdded, this, &FilterProxyModel::notifyColumnsAdded);
+            connect(source_, &Model::columnsRemoved, this, &FilterProxyModel::notifyColumnsRemoved);
+            connect(source_, &Model::columnsMoved, this, &FilterProxyModel::notifyColumnsMoved);
+            connect(source_, &Model::modelAboutToReset, this, &FilterProxyModel::beginReset);
+            connect(source_, &Model::modelReset, this, &FilterProxyModel::onSourceModelReset);
+            connect(source_, &Model::layoutAboutToChange, this, &FilterProxyModel::onSourceLayoutAboutToChange);
+            connect(source_, &Model::layoutChanged, this, &FilterProxyModel::onSourceLayoutChanged);
+        }
+        clearFilter();
+    }
+
+    /**
+     * \brief Shows only the source rows whose bit is set in \p selection
+     *
+     * Resets the proxy.
+     */
+    void setFilter(Bitmap selection)
+    {
+        beginReset();
+        selection.resize(source_ ? source_->rowCount() : 0);
+        selection_ = std::move(selection);
+        rebuildRows();
+        endReset();
+    }
+
+    /**
+     * \brief Shows all the source rows
+     */
+    void clearFilter()
+    {
+        setFilter(Bitmap(source_ ? source_->rowCount() : 0, true));
+    }
+
+    /**
+     * \brief Source rows currently shown
+     */
+    const Bitmap& filter() const
+    {
+        return selection_;
+    }
+
+    /**
+     * \brief Source row for the given proxy row
+     */
+    int mapToSource(int row) const
+    {
+        return rows_[row];
+    }
+
+    /**
+     * \brief Proxy row for the given source row, -1 if it's filtered out
+     */
+    int mapFromSource(int source_row) const
+    {
+        auto iter = std::lower_bound(rows_.begin(), rows_.end(), source_row);
+        if ( iter == rows_.end() || *iter != source_row )
+            return -1;
+        return iter - rows_.begin();
+    }
+
+    Index mapToSource(const Index& index) const
+    {
+        if ( !valid(index) )
+            return {};
+        return source_->index(rows_[index.row()], index.column());
+    }
+
+    Index mapFromSource(const Index& index) const
+    {
+        if ( !index.valid() || index.model() != source_ || index.parent().valid() )
+            return {};
+        int row = mapFromSource(index.row());
+        return row == -1 ? Index() : this->index(row, index.column());
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : rows_.size();
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() || !source_ ? 0 : source_->columnCount();
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < int(rows_.size()) && index.column() < columnCount();
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        return source_->data(mapToSource(index), role);
+    }
+
+    bool onSetData(const Index& index, const QVariant& value, int role) override
+    {
+        return source_->setData(mapToSource(index), value, role);
+    }
+
+private:
+    /**
+     * \brief First proxy row mapped to a source row not less than \p source_row
+     */
+    int lowerBound(int source_row) const
+    {
+        return std::lower_bound(rows_.begin(), rows_.end(), source_row) - rows_.begin();
+    }
+
+    /**
+     * \brief Recomputes the proxy to source mapping from the selection
+     */
+    void rebuildRows()
+    {
+        rows_.clear();
+        for ( int row = selection_.nextSet(0); row < selection_.size();
+                row = selection_.nextSet(row + 1) )
+            rows_.push_back(row);
+    }
+
+    void onSourceDataChanged(const Index& index, const QVariant& value, int role)
+    {
+        Index proxy = mapFromSource(index);
+        if ( proxy.valid() )
+            notifyDataChanged(proxy, value, role);
+    }
+
+    void onSourceDataRangeChanged(int row, int column, int row_count,
+                                  int column_count, const Index& parent, int role)
+    {
+        if ( parent.valid() )
+            return;
+        int first = lowerBound(row);
+        int last = lowerBound(row + row_count);
+        if ( last > first )
+            notifyDataRangeChanged(first, column, last - first, column_count, Index(), role);
+    }
+
+    void onSourceRowsAdded(int row, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        selection_.insert(row, count, false);
+        for ( int i = lowerBound(row); i < int(rows_.size()); i++ )
+            rows_[i] += count;
+    }
+
+    void onSourceRowsRemoved(int row, int count, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        selection_.remove(row, count);
+        int first = lowerBound(row);
+        int last = lowerBound(row + count);
+        rows_.erase(rows_.begin() + first, rows_.begin() + last);
+        for ( int i = first; i < int(rows_.size()); i++ )
+            rows_[i] -= count;
+        if ( last > first )
+            notifyRowsRemoved(first, last - first, Index());
+    }
+
+    /**
+     * \brief Appended rows aren't accepted until refiltered, like in onSourceRowsAdded()
+     */
+    void onSourceRowsShifted(int removed, int added, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        onSourceRowsRemoved(0, removed, parent);
+        onSourceRowsAdded(source_->rowCount() - added, added, parent);
+    }
+
+    void onSourceRowsMoved(const Index& from_parent, int from_row, int count,
+                           const Index& to_parent, int to_row)
+    {
+        if ( from_parent.valid() || to_parent.valid() )
+            return;
+
+        int first = lowerBound(from_row);
+        int last = lowerBound(from_row + count);
+        int destination = lowerBound(to_row);
+
+        selection_.move(from_row, count, to_row);
+        rebuildRows();
+
+        if ( last > first )
+            notifyRowsMoved(Index(), first, last - first, Index(), destination);
+    }
+
+    void onSourceModelReset()
+    {
+        clearFilter();
+        endReset();
+    }
+
+    void onSourceLayoutAboutToChange(const Index& parent)
+    {
+        if ( !parent.valid() )
+            beginLayoutChange();
+    }
+
+    /**
+     * \brief Moves the selection along with the source rows
+     *
+     * Without a permutation the shown rows can't be followed, so the filter
+     * is cleared unless all the rows were shown anyway.
+     */
+    void onSourceLayoutChanged(const Index& parent, const QVector<int>& permutation)
+    {
+        if ( parent.valid() )
+            return;
+
+        if ( permutation.size() != selection_.size() )
+        {
+            endLayoutChange();
+            if ( selection_.count() != selection_.size() )
+                clearFilter();
+            return;
+        }
+
+        std::vector<int> old_rows;
+        old_rows.swap(rows_);
+        Bitmap selection(selection_.size());
+        for ( int row : old_rows )
+            selection.set(permutation[row]);
+        selection_ = std::move(selection);
+        rebuildRows();
+
+        QVector<int> proxy_permutation(old_rows.size());
+        for ( int i = 0; i < int(old_rows.size()); i++ )
+            proxy_permutation[i] = lowerBound(permutation[old_rows[i]]);
+        endLayoutChange(Index(), proxy_permutation);
+    }
+
+    Model* source_ = nullptr;
+    Bitmap selection_;
+    std::vector<int> rows_;
+};
+
+} // namespace imv
+#endif // IMV_FILTER_PROXY_MODEL_HPP
@@ -0,0 +1,595 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_HEADER_MODEL_HPP
+#define IMV_HEADER_MODEL_HPP
+
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <vector>
+#include <QHash>
+#include <QtAlgorithms>
+#include "model.hpp"
+#include "column.hpp"
+
+namespace imv {
+
+/**
+ * \brief Header sections for the top-level rows and columns of a model
+ *
+ * Holds per-section data by orientation and role and the order in which
+ * sections are shown. Logical sections are the model rows and columns,
+ * visual sections are their position on screen.
+ *
+ * The logical to visual map is a permutation stored together with its
+ * inverse, while sections haven't been reordered it's the identity and
+ * isn't stored at all. Hidden sections are tracked in a bitmap indexed by
+ * visual position so visible sections can be found skipping whole words.
+ *
+ * When the model moves sections and the order is still the identity,
+ * the visual order follows the model. Once sections have been reordered
+ * with moveSection(), model moves only relabel the logical indices and
+ * the order on screen is kept.
+ *
+ * Model moves are recorded as runs of logical sections and applied to the
+ * map and the section data when they are next looked up, so a burst of
+ * moves costs a single pass over the sections. Each move only splits and
+ * reorders the runs left by the moves still pending.
+ */
+class HeaderModel : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HeaderModel(Model* model)
+    {
+        resize(horizontal_, model->columnCount());
+        resize(vertical_, model->rowCount());
+
+        connect(model, &Model::columnsAdded, this, &HeaderModel::onColumnsAdded);
+        connect(model, &Model::columnsRemoved, this, &HeaderModel::onColumnsRemoved);
+        connect(model, &Model::columnsMoved, this, &HeaderModel::onColumnsMoved);
+        connect(model, &Model::rowsAdded, this, &HeaderModel::onRowsAdded);
+        connect(model, &Model::rowsRemoved, this, &HeaderModel::onRowsRemoved);
+        connect(model, &Model::rowsShifted, this, &HeaderModel::onRowsShifted);
+        connect(model, &Model::rowsMoved, this, &HeaderModel::onRowsMoved);
+        connect(model, &Model::modelReset, this, [this, model]{
+            horizontal_ = Sections();
+            vertical_ = Sections();
+            resize(horizontal_, model->columnCount());
+            resize(vertical_, model->rowCount());
+        });
+        connect(model, &Model::layoutChanged, this, &HeaderModel::onLayoutChanged);
+    }
+
+    /**
+     * \brief Number of sections
+     */
+    int count(Qt::Orientation orientation) const
+    {
+        return sections(orientation).count;
+    }
+
+    /**
+     * \brief Data for a logical section
+     */
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Value) const
+    {
+        const Sections& sect = sections(orientation);
+        auto iter = sect.data.find(section);
+        if ( iter == sect.data.end() )
+            return QVariant();
+        return iter->second.value(role);
+    }
+
+    /**
+     * \brief Sets the data for a logical section
+     * \returns \b true on success
+     *
+     * An invalid \p value removes the data for \p role.
+     * Emits headerDataChanged() on success.
+     */
+    bool setHeaderData(int section, Qt::Orientation orientation,
+                       const QVariant& value, int role = Value)
+    {
+        Sections& sect = sections(orientation);
+        if ( section < 0 || section >= sect.count )
+            return false;
+
+        if ( value.isValid() )
+        {
+            sect.data[section].insert(role, value);
+        }
+        else
+        {
+            auto iter = sect.data.find(section);
+            if ( iter != sect.data.end() )
+            {
+                iter->second.remove(role);
+                if ( iter->second.isEmpty() )
+                    sect.data.erase(iter);
+            }
+        }
+
+        emit headerDataChanged(orientation, section, role);
+        return true;
+    }
+
+    /**
+     * \brief Position on screen of a logical section
+     * \returns -1 if \p logical is out of range
+     */
+    int visualIndex(Qt::Orientation orientation, int logical) const
+    {
+        const Sections& sect = sections(orientation);
+        if ( logical < 0 || logical >= sect.count )
+            return -1;
+        return sect.to_visual.empty() ? logical : sect.to_visual[logical];
+    }
+
+    /**
+     * \brief Logical section shown at a visual position
+     * \returns -1 if \p visual is out of range
+     */
+    int logicalIndex(Qt::Orientation orientation, int visual) const
+    {
+        const Sections& sect = sections(orientation);
+        if ( visual < 0 || visual >= sect.count )
+            return -1;
+        return sect.to_logical.empty() ? visual : sect.to_logical[visual];
+    }
+
+    /**
+     * \brief Moves the section at visual position \p from to \p to
+     *
+     * Only sections between \p from and \p to are updated.
+     * Emits sectionMoved() on success.
+     */
+    bool moveSection(Qt::Orientation orientation, int from, int to)
+    {
+        Sections& sect = sections(orientation);
+        if ( from < 0 || from >= sect.count || to < 0 || to >= sect.count )
+            return false;
+        if ( from == to )
+            return true;
+
+        if ( sect.to_logical.empty() )
+        {
+            sect.to_logical.resize(sect.count);
+            std::iota(sect.to_logical.begin(), sect.to_logical.end(), 0);
+            sect.to_visual = sect.to_logical;
+        }
+
+        int logical = sect.to_logical[from];
+        auto begin = sect.to_logical.begin();
+        if ( from < to )
+            std::rotate(begin + from, begin + from + 1, begin + to + 1);
+        else
+            std::rotate(begin + to, begin + from, begin + from + 1);
+
+        for ( int visual = std::min(from, to); visual <= std::max(from, to); visual++ )
+            sect.to_visual[sect.to_logical[visual]] = visual;
+
+        bool visible = sect.visible[from];
+        sect.visible.remove(from, 1);
+        sect.visible.insert(to, 1, visible);
+
+        emit sectionMoved(orientation, logical, from, to);
+        return true;
+    }
+
+    /**
+     * \brief Restores the identity order for the sections
+     */
+    void resetSectionOrder(Qt::Orientation orientation)
+    {
+        Sections& sect = sections(orientation);
+        if ( sect.to_logical.empty() )
+            return;
+
+        Bitmap visible(sect.count);
+        for ( int logical = 0; logical < sect.count; logical++ )
+            visible.set(logical, sect.visible[sect.to_visual[logical]]);
+        sect.visible = visible;
+        sect.to_logical.clear();
+        sect.to_visual.clear();
+    }
+
+    /**
+     * \brief Whether the order differs from the model order
+     */
+    bool sectionsMoved(Qt::Orientation orientation) const
+    {
+        return !sections(orientation).to_logical.empty();
+    }
+
+    /**
+     * \brief Hides or shows a logical section
+     */
+    void setSectionHidden(Qt::Orientation orientation, int logical, bool hidden)
+    {
+        int visual = visualIndex(orientation, logical);
+        if ( visual == -1 )
+            return;
+
+        Sections& sect = sections(orientation);
+        if ( sect.visible[visual] != hidden )
+            return;
+
+        sect.visible.set(visual, !hidden);
+        sect.visible_count += hidden ? -1 : 1;
+        emit sectionHiddenChanged(orientation, logical, hidden);
+    }
+
+    bool isSectionHidden(Qt::Orientation orientation, int logical) const
+    {
+        int visual = visualIndex(orientation, logical);
+        return visual == -1 || !sections(orientation).visible[visual];
+    }
+
+    /**
+     * \brief Number of sections which aren't hidden
+     */
+    int visibleCount(Qt::Orientation orientation) const
+    {
+        return sections(orientation).visible_count;
+    }
+
+    /**
+     * \brief First visible section at or after the visual position \p visual
+     * \returns count() if there are no more visible sections
+     */
+    int nextVisible(Qt::Orientation orientation, int visual) const
+    {
+        return sections(orientation).visible.nextSet(std::max(visual, 0));
+    }
+
+    /**
+     * \brief Visual position of the \p n-th visible section
+     * \returns -1 if there are fewer visible sections
+     */
+    int visibleSection(Qt::Orientation orientation, int n) const
+    {
+        if ( n < 0 )
+            return -1;
+
+        const auto& words = sections(orientation).visible.words();
+        for ( int i = 0; i < int(words.size()); i++ )
+        {
+            int bits = qPopulationCount(words[i]);
+            if ( n < bits )
+            {
+                quint64 word = words[i];
+                for ( ; n > 0; n-- )
+                    word &= word - 1;
+                return i * Bitmap::word_bits + qCountTrailingZeroBits(word);
+            }
+            n -= bits;
+        }
+        return -1;
+    }
+
+signals:
+    void headerDataChanged(Qt::Orientation orientation, int section, int role);
+    void sectionMoved(Qt::Orientation orientation, int logical, int from_visual, int to_visual);
+    void sectionHiddenChanged(Qt::Orientation orientation, int logical, bool hidden);
+
+private:
+    /**
+     * \brief Logical sections [first, first + count) before the pending moves
+     */
+    struct Run
+    {
+        int first;
+        int count;
+    };
+
+    struct Sections
+    {
+        int count = 0;
+        int visible_count = 0;
+        /// Logical section -> (role -> value), only for sections with data
+        std::map<int, QHash<int, QVariant>> data;
+        /// Visual -> logical, empty for the identity
+        std::vector<int> to_logical;
+        /// Logical -> visual, empty for the identity
+        std::vector<int> to_visual;
+        /// Indexed by visual position
+        Bitmap visible;
+        /// Logical sections in their order after the model moves not applied
+        /// to data and to_logical yet, empty if there are none
+        std::vector<Run> moved;
+    };
+
+    Sections& sections(Qt::Orientation orientation)
+    {
+        Sections& sect = orientation == Qt::Horizontal ? horizontal_ : vertical_;
+        applyMoves(sect);
+        return sect;
+    }
+
+    const Sections& sections(Qt::Orientation orientation) const
+    {
+        Sections& sect = orientation == Qt::Horizontal ? horizontal_ : vertical_;
+        applyMoves(sect);
+        return sect;
+    }
+
+    static void resize(Sections& sect, int count)
+    {
+        sect.count = sect.visible_count = count;
+        sect.visible.resize(count, true);
+    }
+
+    /**
+     * \brief Rebuilds the logical to visual map from the visual to logical one
+     */
+    static void updateInverse(Sections& sect)
+    {
+        sect.to_visual.resize(sect.count);
+        for ( int visual = 0; visual < sect.count; visual++ )
+            sect.to_visual[sect.to_logical[visual]] = visual;
+    }
+
+    /**
+     * \brief Replaces the keys in \p data with \p relabel(key), dropping negative ones
+     */
+    template<class Func>
+        static void relabelData(Sections& sect, const Func& relabel)
+        {
+            std::map<int, QHash<int, QVariant>> data;
+            for ( auto& item : sect.data )
+            {
+                int section = relabel(item.first);
+                if ( section >= 0 )
+                    data.emplace(section, std::move(item.second));
+            }
+            sect.data.swap(data);
+        }
+
+    /**
+     * \brief Splits the run containing \p section so that one starts at \p section
+     */
+    static void splitRun(std::vector<Run>& runs, int section)
+    {
+        for ( auto run = runs.begin(); run != runs.end(); section -= run->count, ++run )
+        {
+            if ( section == 0 )
+                return;
+            if ( section < run->count )
+            {
+                Run tail{run->first + section, run->count - section};
+                run->count = section;
+                runs.insert(run + 1, tail);
+                return;
+            }
+        }
+    }
+
+    /**
+     * \brief Index of the run starting at \p section
+     */
+    static int runAt(const std::vector<Run>& runs, int section)
+    {
+        int index = 0;
+        for ( ; index < int(runs.size()) && section > 0; index++ )
+            section -= runs[index].count;
+        return index;
+    }
+
+    /**
+     * \brief Relabels data and to_logical with the pending model moves
+     */
+    static void applyMoves(Sections& sect)
+    {
+        if ( sect.moved.empty() )
+            return;
+
+        std::vector<int> relabel(sect.count);
+        int logical = 0;
+        for ( const Run& run : sect.moved )
+            for ( int i = 0; i < run.count; i++ )
+                relabel[run.first + i] = logical++;
+        sect.moved.clear();
+
+        relabelData(sect, [&relabel](int section) { return relabel[section]; });
+        if ( !sect.to_logical.empty() )
+        {
+            for ( auto& logical : sect.to_logical )
+                logical = relabel[logical];
+            updateInverse(sect);
+        }
+    }
+
+    static void insertSections(Sections& sect, int first, int count)
+    {
+        applyMoves(sect);
+        auto shift = [first, count](int section) {
+            return section >= first ? section + count : section;
+        };
+        relabelData(sect, shift);
+
+        if ( sect.to_logical.empty() )
+        {
+            sect.visible.insert(first, count, true);
+        }
+        else
+        {
+            int visual = first < sect.count ? sect.to_visual[first] : sect.count;
+            for ( auto& logical : sect.to_logical )
+                logical = shift(logical);
+            sect.to_logical.insert(sect.to_logical.begin() + visual, count, 0);
+            std::iota(sect.to_logical.begin() + visual,
+                      sect.to_logical.begin() + visual + count, first);
+            sect.visible.insert(visual, count, true);
+        }
+
+        sect.count += count;
+        sect.visible_count += count;
+        if ( !sect.to_logical.empty() )
+            updateInverse(sect);
+    }
+
+    static void removeSections(Sections& sect, int first, int count)
+    {
+        applyMoves(sect);
+        auto shift = [first, count](int section) {
+            if ( section < first )
+                return section;
+            if ( section < first + count )
+                return -1;
+            return section - count;
+        };
+        relabelData(sect, shift);
+
+        if ( sect.to_logical.empty() )
+        {
+            sect.visible.remove(first, count);
+        }
+        else
+        {
+            Bitmap visible(sect.count - count);
+            int visual = 0;
+            for ( int old_visual = 0; old_visual < sect.count; old_visual++ )
+            {
+                int logical = shift(sect.to_logical[old_visual]);
+                if ( logical < 0 )
+                    continue;
+                sect.to_logical[visual] = logical;
+                visible.set(visual, sect.visible[old_visual]);
+                visual++;
+            }
+            sect.to_logical.resize(visual);
+            sect.visible = visible;
+        }
+
+        sect.count -= count;
+        sect.visible_count = sect.visible.count();
+        if ( !sect.to_logical.empty() )
+            updateInverse(sect);
+    }
+
+    /**
+     * \brief Records a model move, without a permutation the visual order follows it
+     */
+    static void moveSections(Sections& sect, int from, int count, int to)
+    {
+        if ( sect.to_logical.empty() )
+            sect.visible.move(from, count, to);
+        if ( sect.to_logical.empty() && sect.data.empty() )
+            return;
+
+        if ( sect.moved.empty() )
+            sect.moved.push_back(Run{0, sect.count});
+        splitRun(sect.moved, from);
+        splitRun(sect.moved, from + count);
+        splitRun(sect.moved, to);
+        int first = runAt(sect.moved, from);
+        int last = runAt(sect.moved, from + count);
+        detail::moveRange(sect.moved, first, last - first, runAt(sect.moved, to));
+    }
+
+    void onColumnsAdded(int column, int count, const Index& parent)
+    {
+        if ( !parent.valid() )
+            insertSections(horizontal_, column, count);
+    }
+
+    void onColumnsRemoved(int column, int count, const Index& parent)
+    {
+        if ( !parent.valid() )
+            removeSections(horizontal_, column, count);
+    }
+
+    void onColumnsMoved(const Index& from_parent, int from_column, int count,
+                        const Index& to_parent, int to_column)
+    {
+        if ( !from_parent.valid() && !to_parent.valid() )
+            moveSections(horizontal_, from_column, count, to_column);
+    }
+
+    void onRowsAdded(int row, int count, const Index& parent)
+    {
+        if ( !parent.valid() )
+            insertSections(vertical_, row, count);
+    }
+
+    void onRowsRemoved(int row, int count, const Index& parent)
+    {
+        if ( !parent.valid() )
+            removeSections(vertical_, row, count);
+    }
+
+    void onRowsShifted(int removed, int added, const Index& parent)
+    {
+        if ( parent.valid() )
+            return;
+        removeSections(vertical_, 0, removed);
+        insertSections(vertical_, vertical_.count, added);
+    }
+
+    void onRowsMoved(const Index& from_parent, int from_row, int count,
+                     const Index& to_parent, int to_row)
+    {
+        if ( !from_parent.valid() && !to_parent.valid() )
+            moveSections(vertical_, from_row, count, to_row);
+    }
+
+    /**
+     * \brief Vertical sections follow their rows, without a permutation only their count is kept
+     */
+    void onLayoutChanged(const Index& parent, const QVector<int>& permutation)
+    {
+        if ( parent.valid() )
+            return;
+
+        applyMoves(vertical_);
+        if ( permutation.size() != vertical_.count )
+        {
+            int count = vertical_.count;
+            vertical_ = Sections();
+            resize(vertical_, count);
+            return;
+        }
+
+        relabelData(vertical_, [&permutation](int section) { return permutation[section]; });
+        if ( vertical_.to_logical.empty() )
+        {
+            Bitmap visible(vertical_.count);
+            for ( int row = 0; row < vertical_.count; row++ )
+                visible.set(permutation[row], vertical_.visible[row]);
+            vertical_.visible = visible;
+        }
+        else
+        {
+            for ( auto& logical : vertical_.to_logical )
+                logical = permutation[logical];
+            updateInverse(vertical_);
+        }
+    }
+
+    /// Mutable as the pending moves are applied on lookup
+    mutable Sections horizontal_;
+    mutable Sections vertical_;
+};
+
+} // namespace imv
+#endif // IMV_HEADER_MODEL_HPP
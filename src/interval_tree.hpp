@@ -0,0 +1,222 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_INTERVAL_TREE_HPP
+#define IMV_INTERVAL_TREE_HPP
+
+#include <algorithm>
+#include <vector>
+
+namespace imv {
+
+/**
+ * \brief Set of half-open intervals [begin, end) with a value each
+ *
+ * Intervals are kept sorted by their start in an implicit balanced tree,
+ * where each node stores the largest end in its subtree. Finding the
+ * intervals overlapping a range costs O(log n + matches).
+ *
+ * Insertions and removals only mark the tree as unsorted, it's rebuilt
+ * by the next query, so changing many intervals at once is cheap.
+ * update() moves a single interval without a rebuild when it can.
+ */
+template<class T>
+    class IntervalTree
+    {
+    public:
+        int size() const
+        {
+            return nodes_.size();
+        }
+
+        bool empty() const
+        {
+            return nodes_.empty();
+        }
+
+        void insert(int begin, int end, const T& value)
+        {
+            nodes_.push_back(Node{begin, end, end, value});
+            sorted_ = false;
+        }
+
+        /**
+         * \brief Removes the intervals whose value satisfies \p predicate
+         * \returns The number of removed intervals
+         */
+        template<class Predicate>
+            int removeIf(const Predicate& predicate)
+            {
+                auto iter = std::remove_if(nodes_.begin(), nodes_.end(),
+                    [&predicate](const Node& node) { return predicate(node.value); });
+                int removed = nodes_.end() - iter;
+                nodes_.erase(iter, nodes_.end());
+                if ( removed )
+                    sorted_ = false;
+                return removed;
+            }
+
+        /**
+         * \brief Moves the first interval whose value satisfies \p predicate
+         *        to [begin, end) and calls \p modify on its value
+         * \returns \b false if no value satisfies \p predicate
+         *
+         * Finding the interval is linear. If it stays between its neighbours
+         * the tree is fixed in O(log n), otherwise it's marked as unsorted.
+         */
+        template<class Predicate, class Modify>
+            bool update(const Predicate& predicate, int begin, int end, const Modify& modify)
+            {
+                auto iter = std::find_if(nodes_.begin(), nodes_.end(),
+                    [&predicate](const Node& node) { return predicate(node.value); });
+                if ( iter == nodes_.end() )
+                    return false;
+
+                modify(iter->value);
+                iter->begin = begin;
+                iter->end = end;
+                if ( !sorted_ )
+                    return true;
+
+                int index = iter - nodes_.begin();
+                if ( (index > 0 && nodes_[index - 1].begin > begin) ||
+                     (index + 1 < int(nodes_.size()) && nodes_[index + 1].begin < begin) )
+                    sorted_ = false;
+                else
+                    refresh(0, nodes_.size(), index);
+                return true;
+            }
+
+        void clear()
+        {
+            nodes_.clear();
+            sorted_ = true;
+        }
+
+        /**
+         * \brief Calls \p func with the value of each interval overlapping [begin, end)
+         */
+        template<class Func>
+            void query(int begin, int end, const Func& func) const
+            {
+                if ( begin >= end || nodes_.empty() )
+                    return;
+                if ( !sorted_ )
+                    build();
+                query(0, nodes_.size(), begin, end, func);
+            }
+
+        /**
+         * \brief Calls \p func with the value of each interval
+         */
+        template<class Func>
+            void forEach(const Func& func) const
+            {
+                for ( const Node& node : nodes_ )
+                    func(node.value);
+            }
+
+    private:
+        struct Node
+        {
+            int begin;
+            int end;
+            /// Largest end in the subtree rooted at this node
+            int max_end;
+            T value;
+        };
+
+        void build() const
+        {
+            std::sort(nodes_.begin(), nodes_.end(), [](const Node& a, const Node& b) {
+                return a.begin < b.begin;
+            });
+            build(0, nodes_.size());
+            sorted_ = true;
+        }
+
+        /**
+         * \brief Computes max_end for the subtree of [first, last), rooted at the middle
+         * \returns The max_end of the root
+         */
+        int build(int first, int last) const
+        {
+            int middle = first + (last - first) / 2;
+            Node& node = nodes_[middle];
+            node.max_end = node.end;
+            if ( first < middle )
+                node.max_end = std::max(node.max_end, build(first, middle));
+            if ( middle + 1 < last )
+                node.max_end = std::max(node.max_end, build(middle + 1, last));
+            return node.max_end;
+        }
+
+        /**
+         * \brief Recomputes max_end on the path from the root of [first, last) to \p index
+         */
+        void refresh(int first, int last, int index)
+        {
+            int middle = first + (last - first) / 2;
+            Node& node = nodes_[middle];
+            if ( index < middle )
+                refresh(first, middle, index);
+            else if ( index > middle )
+                refresh(middle + 1, last, index);
+
+            node.max_end = node.end;
+            if ( first < middle )
+                node.max_end = std::max(node.max_end, maxEnd(first, middle));
+            if ( middle + 1 < last )
+                node.max_end = std::max(node.max_end, maxEnd(middle + 1, last));
+        }
+
+        /**
+         * \brief max_end of the root of the non-empty range [first, last)
+         */
+        int maxEnd(int first, int last) const
+        {
+            return nodes_[first + (last - first) / 2].max_end;
+        }
+
+        template<class Func>
+            void query(int first, int last, int begin, int end, const Func& func) const
+            {
+                if ( first >= last )
+                    return;
+                int middle = first + (last - first) / 2;
+                const Node& node = nodes_[middle];
+                // Nothing in this subtree ends after the range starts
+                if ( node.max_end <= begin )
+                    return;
+                query(first, middle, begin, end, func);
+                // Nodes on the right start after this one
+                if ( node.begin >= end )
+                    return;
+                if ( node.end > begin )
+                    func(node.value);
+                query(middle + 1, last, begin, end, func);
+            }
+
+        mutable std::vector<Node> nodes_;
+        mutable bool sorted_ = true;
+    };
+
+} // namespace imv
+#endif // IMV_INTERVAL_TREE_HPP
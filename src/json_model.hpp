@@ -0,0 +1,623 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_JSON_MODEL_HPP
+#define IMV_JSON_MODEL_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include "model.hpp"
+
+namespace imv {
+
+/**
+ * \brief Tree model showing a JSON document
+ *
+ * Objects and arrays are parents, their members and elements are the
+ * children. The first column is the member name (or the element index),
+ * the second one the value, which is empty for objects and arrays.
+ *
+ * Loading only builds a tape with one small entry for each value in the
+ * document, recording where the value starts, where its parent is and
+ * where the values after it start. Strings and numbers are decoded by
+ * data() when requested, and the list of children of a parent is built
+ * the first time the parent is accessed.
+ *
+ * Files are memory mapped so only the parts being shown are read from
+ * the disk after loading.
+ *
+ * \note Loading checks the structure of the document, malformed numbers
+ *       and literals are only detected when decoded and show as empty.
+ */
+class JsonModel : public Model
+{
+public:
+    enum Column
+    {
+        KeyColumn,
+        ValueColumn,
+        ColumnCount
+    };
+
+    JsonModel() = default;
+
+    /**
+     * \brief Loads the document from \p json, which is kept without copying
+     * \returns \b false if the document is malformed
+     * \see errorString()
+     */
+    bool load(const QByteArray& json)
+    {
+        // Listeners can still read the old document while the reset begins
+        beginReset();
+        file_.close();
+        bytes_ = json;
+        bool ok = setDocument(bytes_.constData(), bytes_.size());
+        endReset();
+        return ok;
+    }
+
+    /**
+     * \brief Loads the document from the file at \p path, mapping it in memory
+     * \returns \b false if the file can't be read or is malformed
+     * \see errorString()
+     */
+    bool loadFile(const QString& path)
+    {
+        beginReset();
+        bool ok = openFile(path);
+        endReset();
+        return ok;
+    }
+
+    /**
+     * \brief Description of the last loading error
+     */
+    QString errorString() const
+    {
+        return error_;
+    }
+
+    /**
+     * \brief Byte offset of the last loading error, -1 if not in the document
+     */
+    qint64 errorOffset() const
+    {
+        return error_offset_;
+    }
+
+    /**
+     * \brief Number of values in the document
+     */
+    int valueCount() const
+    {
+        return tape_.size();
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        quint32 node = nodeId(parent);
+        if ( node != none && !isContainer(node) )
+            return 0;
+        return children(node).size();
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return ColumnCount;
+    }
+
+    Index onIndex(int row, int column, const Index& parent) const override
+    {
+        const std::vector<quint32>& list = children(nodeId(parent));
+        if ( row >= int(list.size()) || column >= ColumnCount )
+            return {};
+        return createIndex(row, column, quintptr(list[row]) + 1);
+    }
+
+    Index onParent(const Index& index) const override
+    {
+        if ( !index.internalId() || index.internalId() > tape_.size() )
+            return {};
+        quint32 parent = parentOf(index.internalId() - 1);
+        if ( parent == none )
+            return {};
+        return createIndex(rowOf(parent), 0, quintptr(parent) + 1);
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        if ( !index.internalId() || index.internalId() > tape_.size() ||
+             index.column() >= ColumnCount )
+            return false;
+        quint32 node = index.internalId() - 1;
+        const std::vector<quint32>& list = children(parentOf(node));
+        return index.row() < int(list.size()) && list[index.row()] == node;
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return QVariant();
+
+        quint32 node = index.internalId() - 1;
+        if ( index.column() == KeyColumn )
+        {
+            if ( tape_[node].member )
+                return decodeString(tape_[node].offset);
+            if ( parentOf(node) != none )
+                return index.row();
+            return QVariant();
+        }
+
+        if ( isContainer(node) )
+            return QVariant();
+        return decodeScalar(valueOffset(node));
+    }
+
+private:
+    /**
+     * \brief Replaces the document with the contents of \p path, inside a reset
+     */
+    bool openFile(const QString& path)
+    {
+        file_.close();
+        bytes_.clear();
+        file_.setFileName(path);
+        if ( !file_.open(QIODevice::ReadOnly) )
+        {
+            error_ = file_.errorString();
+            error_offset_ = -1;
+            return setDocument(nullptr, 0, false);
+        }
+
+        if ( file_.size() == 0 )
+            return setDocument("", 0);
+
+        if ( uchar* map = file_.map(0, file_.size()) )
+            return setDocument(reinterpret_cast<const char*>(map), file_.size());
+
+        // Mapping isn't supported by every file system
+        bytes_ = file_.readAll();
+        file_.close();
+        return setDocument(bytes_.constData(), bytes_.size());
+    }
+
+    enum : quint32 { none = quint32(-1) };
+
+    /**
+     * \brief Tape entry for a value
+     */
+    struct Node
+    {
+        /// Start of the value, or of its key if \c member
+        quint64 offset : 63;
+        quint64 member : 1;
+        /// Tape index past the value and its descendants
+        quint32 next;
+        /// Tape index of the enclosing object or array
+        quint32 parent;
+    };
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    qint64 skipSpace(qint64 pos) const
+    {
+        while ( pos < size_ && isSpace(data_[pos]) )
+            pos++;
+        return pos;
+    }
+
+    /**
+     * \brief Position past the string starting at \p pos, -1 if unterminated
+     */
+    qint64 skipString(qint64 pos) const
+    {
+        const char* begin = data_ + pos + 1;
+        const char* end = data_ + size_;
+        while ( begin < end )
+        {
+            auto quote = static_cast<const char*>(std::memchr(begin, '"', end - begin));
+            if ( !quote )
+                return -1;
+            // The quote is escaped by an odd number of backslashes
+            const char* escape = quote;
+            while ( escape > data_ + pos + 1 && escape[-1] == '\\' )
+                escape--;
+            if ( (quote - escape) % 2 == 0 )
+                return quote - data_ + 1;
+            begin = quote + 1;
+        }
+        return -1;
+    }
+
+    bool fail(const QString& message, qint64 offset)
+    {
+        error_ = message;
+        error_offset_ = offset;
+        tape_.clear();
+        return false;
+    }
+
+    /**
+     * \brief Replaces the document, resetting the model
+     */
+    bool setDocument(const char* data, qint64 size, bool parse = true)
+    {
+        beginReset();
+        data_ = data;
+        size_ = size;
+        children_.clear();
+        top_.clear();
+        // Nodes of the previous document point into its buffer
+        tape_.clear();
+        bool ok = parse && buildTape();
+        if ( ok )
+        {
+            error_.clear();
+            error_offset_ = -1;
+        }
+
+        endReset();
+        return ok;
+    }
+
+    /**
+     * \brief Builds the tape, checking the structure of the document
+     */
+    bool buildTape()
+    {
+        tape_.clear();
+
+        enum { ExpectValue, ExpectKey, ExpectSeparator } state = ExpectValue;
+        // An object or array has just been opened and can be closed right away
+        bool can_close = false;
+        std::vector<quint32> open;
+        std::vector<bool> open_object;
+
+        for ( qint64 pos = skipSpace(0); pos < size_; pos = skipSpace(pos) )
+        {
+            char c = data_[pos];
+            quint32 parent = open.empty() ? quint32(none) : open.back();
+            bool object = !open_object.empty() && open_object.back();
+
+            if ( state == ExpectSeparator )
+            {
+                if ( parent == none )
+                    return fail(QStringLiteral("Unexpected data after the document"), pos);
+                if ( c == ',' )
+                {
+                    state = object ? ExpectKey : ExpectValue;
+                    can_close = false;
+                    pos++;
+                }
+                else if ( c == (object ? '}' : ']') )
+                {
+                    tape_[parent].next = tape_.size();
+                    open.pop_back();
+                    open_object.pop_back();
+                    pos++;
+                }
+                else
+                {
+                    return fail(QStringLiteral("Expected ',' or the end of the container"), pos);
+                }
+                continue;
+            }
+
+            if ( can_close && c == (object ? '}' : ']') )
+            {
+                tape_[parent].next = tape_.size();
+                open.pop_back();
+                open_object.pop_back();
+                state = ExpectSeparator;
+                can_close = false;
+                pos++;
+                continue;
+            }
+
+            if ( tape_.size() >= none )
+                return fail(QStringLiteral("Too many values"), pos);
+
+            Node node{quint64(pos), 0, 0, parent};
+            if ( state == ExpectKey )
+            {
+                if ( c != '"' )
+                    return fail(QStringLiteral("Expected a member name"), pos);
+                pos = skipString(pos);
+                if ( pos < 0 )
+                    return fail(QStringLiteral("Unterminated string"), node.offset);
+                pos = skipSpace(pos);
+                if ( pos >= size_ || data_[pos] != ':' )
+                    return fail(QStringLiteral("Expected ':'"), pos);
+                pos = skipSpace(pos + 1);
+                if ( pos >= size_ )
+                    break;
+                node.member = 1;
+                c = data_[pos];
+            }
+
+            quint32 id = tape_.size();
+            node.next = id + 1;
+            tape_.push_back(node);
+
+            if ( c == '{' || c == '[' )
+            {
+                open.push_back(id);
+                open_object.push_back(c == '{');
+                state = c == '{' ? ExpectKey : ExpectValue;
+                can_close = true;
+                pos++;
+                continue;
+            }
+
+            if ( c == '"' )
+            {
+                qint64 start = pos;
+                pos = skipString(pos);
+                if ( pos < 0 )
+                    return fail(QStringLiteral("Unterminated string"), start);
+            }
+            else if ( c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n' )
+            {
+                while ( pos < size_ && !isSpace(data_[pos]) && data_[pos] != ',' &&
+                        data_[pos] != ']' && data_[pos] != '}' )
+                    pos++;
+            }
+            else
+            {
+                return fail(QStringLiteral("Unexpected character"), pos);
+            }
+            state = ExpectSeparator;
+            can_close = false;
+        }
+
+        if ( tape_.empty() )
+            return fail(QStringLiteral("Empty document"), size_);
+        if ( !open.empty() || state != ExpectSeparator )
+            return fail(QStringLiteral("Unexpected end of the document"), size_);
+        return true;
+    }
+
+    quint32 nodeId(const Index& index) const
+    {
+        if ( index.model() == this && index.internalId() )
+            return index.internalId() - 1;
+        return none;
+    }
+
+    qint64 valueOffset(quint32 node) const
+    {
+        qint64 pos = tape_[node].offset;
+        if ( !tape_[node].member )
+            return pos;
+        // Skip the key and the colon, already checked when loading
+        pos = skipSpace(skipString(pos));
+        return skipSpace(pos + 1);
+    }
+
+    bool isContainer(quint32 node) const
+    {
+        char c = data_[valueOffset(node)];
+        return c == '{' || c == '[';
+    }
+
+    /**
+     * \brief Parent shown in the model, the top-level container is the invisible root
+     */
+    quint32 parentOf(quint32 node) const
+    {
+        quint32 parent = tape_[node].parent;
+        return parent == 0 && isContainer(0) ? quint32(none) : parent;
+    }
+
+    int rowOf(quint32 node) const
+    {
+        const std::vector<quint32>& list = children(parentOf(node));
+        return std::lower_bound(list.begin(), list.end(), node) - list.begin();
+    }
+
+    /**
+     * \brief Tape indices of the children shown under \p node, built on first use
+     */
+    const std::vector<quint32>& children(quint32 node) const
+    {
+        if ( node == none )
+        {
+            if ( top_.empty() && !tape_.empty() )
+            {
+                if ( isContainer(0) )
+                    top_ = children(0);
+                else
+                    top_.push_back(0);
+            }
+            return top_;
+        }
+
+        auto iter = children_.find(node);
+        if ( iter == children_.end() )
+        {
+            std::vector<quint32> list;
+            for ( quint32 child = node + 1; child < tape_[node].next; child = tape_[child].next )
+                list.push_back(child);
+            iter = children_.insert(node, list);
+        }
+        return *iter;
+    }
+
+    static int hexDigit(char c)
+    {
+        if ( c >= '0' && c <= '9' )
+            return c - '0';
+        if ( c >= 'a' && c <= 'f' )
+            return c - 'a' + 10;
+        if ( c >= 'A' && c <= 'F' )
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    /**
+     * \brief Reads the 4 hex digits of a \\u escape at \p pos, -1 if invalid
+     */
+    int hex4(qint64 pos, qint64 end) const
+    {
+        if ( pos + 4 > end )
+            return -1;
+        int value = 0;
+        for ( int i = 0; i < 4; i++ )
+        {
+            int digit = hexDigit(data_[pos + i]);
+            if ( digit < 0 )
+                return -1;
+            value = value * 16 + digit;
+        }
+        return value;
+    }
+
+    static void appendUtf8(QByteArray& out, uint code)
+    {
+        if ( code < 0x80 )
+        {
+            out += char(code);
+        }
+        else if ( code < 0x800 )
+        {
+            out += char(0xc0 | (code >> 6));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else if ( code < 0x10000 )
+        {
+            out += char(0xe0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            out += char(0xf0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3f));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    QVariant decodeString(qint64 pos) const
+    {
+        qint64 begin = pos + 1;
+        qint64 end = skipString(pos) - 1;
+        if ( !std::memchr(data_ + begin, '\\', end - begin) )
+            return QString::fromUtf8(data_ + begin, end - begin);
+
+        QByteArray out;
+        out.reserve(end - begin);
+        for ( qint64 i = begin; i < end; i++ )
+        {
+            char c = data_[i];
+            if ( c != '\\' )
+            {
+                out += c;
+                continue;
+            }
+
+            c = data_[++i];
+            switch ( c )
+            {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    int code = hex4(i + 1, end);
+                    if ( code < 0 )
+                        return QVariant();
+                    i += 4;
+                    uint point = code;
+                    if ( code >= 0xd800 && code < 0xdc00 && i + 2 < end &&
+                         data_[i + 1] == '\\' && data_[i + 2] == 'u' )
+                    {
+                        int low = hex4(i + 3, end);
+                        if ( low >= 0xdc00 && low < 0xe000 )
+                        {
+                            point = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                            i += 6;
+                        }
+                    }
+                    appendUtf8(out, point);
+                    break;
+                }
+                default:
+                    out += c;
+            }
+        }
+        return QString::fromUtf8(out);
+    }
+
+    QVariant decodeScalar(qint64 pos) const
+    {
+        if ( data_[pos] == '"' )
+            return decodeString(pos);
+
+        qint64 end = pos;
+        while ( end < size_ && !isSpace(data_[end]) && data_[end] != ',' &&
+                data_[end] != ']' && data_[end] != '}' )
+            end++;
+        QByteArray text = QByteArray::fromRawData(data_ + pos, end - pos);
+
+        if ( text == "true" )
+            return true;
+        if ( text == "false" )
+            return false;
+        if ( text == "null" )
+            return QVariant();
+
+        bool ok = false;
+        qint64 integer = text.toLongLong(&ok);
+        if ( ok )
+            return integer;
+        double real = text.toDouble(&ok);
+        if ( ok )
+            return real;
+        return QVariant();
+    }
+
+    QFile file_;
+    /// Owns the data when not mapped from file_
+    QByteArray bytes_;
+    const char* data_ = nullptr;
+    qint64 size_ = 0;
+    std::vector<Node> tape_;
+    mutable std::vector<quint32> top_;
+    mutable QHash<quint32, std::vector<quint32>> children_;
+    QString error_;
+    qint64 error_offset_ = -1;
+};
+
+} // namespace imv
+#endif // IMV_JSON_MODEL_HPP
@@ -0,0 +1,533 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_MIME_DATA_HPP
+#define IMV_MIME_DATA_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <QDataStream>
+#include <QIODevice>
+#include <QMimeData>
+#include <QPointer>
+#include <QStringList>
+#include "model.hpp"
+
+namespace imv {
+
+/**
+ * \brief Serializes a rectangular range of items, a chunk at a time
+ *
+ * Only the Value role is encoded.
+ * Encoding is incremental so large selections can be written to a device
+ * or spread across event loop iterations without stalling the UI.
+ */
+class MimeEncoder
+{
+public:
+    enum Format
+    {
+        Tsv,    ///< Tab separated values, also used for plain text
+        Html,   ///< HTML table
+        Binary, ///< QDataStream of QVariant, preserves the value types
+    };
+
+    enum
+    {
+        binary_magic = 0x494d5643, ///< "IMVC"
+        binary_version = 1,
+    };
+
+    /**
+     * \brief MIME type for the given format
+     */
+    static QString mimeType(Format format)
+    {
+        switch ( format )
+        {
+            case Tsv:
+                return QStringLiteral("text/tab-separated-values");
+            case Html:
+                return QStringLiteral("text/html");
+            case Binary:
+            default:
+                return QStringLiteral("application/x-imv-cells");
+        }
+    }
+
+    /**
+     * \brief Finds the format for a MIME type
+     * \returns \b false if \p mime_type isn't supported
+     */
+    static bool format(const QString& mime_type, Format& format)
+    {
+        if ( mime_type == mimeType(Binary) )
+            format = Binary;
+        else if ( mime_type == mimeType(Html) )
+            format = Html;
+        else if ( mime_type == mimeType(Tsv) || mime_type == QLatin1String("text/plain") )
+            format = Tsv;
+        else
+            return false;
+        return true;
+    }
+
+    /**
+     * \param model         Model to read from, must outlive the encoder
+     * \param format        Output format
+     * \param row           First row of the range
+     * \param column        First column of the range
+     * \param row_count     Number of rows in the range
+     * \param column_count  Number of columns in the range
+     * \param parent        Parent of the range
+     * \param chunk_rows    Number of rows encoded by each nextChunk()
+     */
+    MimeEncoder(const Model* model, Format format, int row, int column,
+                int row_count, int column_count, const Index& parent = {},
+                int chunk_rows = 4096)
+        : model_(model),
+          format_(format),
+          row_(row),
+          column_(column),
+          row_count_(std::max(row_count, 0)),
+          column_count_(std::max(column_count, 0)),
+          parent_(parent),
+          chunk_rows_(std::max(chunk_rows, 1))
+    {}
+
+    /**
+     * \brief Whether all the output has been produced
+     */
+    bool atEnd() const
+    {
+        return done_;
+    }
+
+    /**
+     * \brief Encodes the next rows
+     * \returns The encoded bytes, empty when atEnd()
+     */
+    QByteArray nextChunk()
+    {
+        QByteArray chunk;
+        if ( done_ )
+            return chunk;
+
+        QDataStream stream(&chunk, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+
+        if ( !started_ )
+        {
+            started_ = true;
+            writeHeader(chunk, stream);
+        }
+
+        int end = std::min(next_row_ + chunk_rows_, row_count_);
+        for ( ; next_row_ < end; next_row_++ )
+            writeRow(chunk, stream, next_row_);
+
+        if ( next_row_ == row_count_ )
+        {
+            done_ = true;
+            if ( format_ == Html )
+                chunk += "</table></body></html>\n";
+        }
+
+        return chunk;
+    }
+
+    /**
+     * \brief Writes the remaining output to \p device
+     * \returns \b false if writing fails
+     */
+    bool encode(QIODevice* device)
+    {
+        while ( !done_ )
+        {
+            QByteArray chunk = nextChunk();
+            if ( device->write(chunk) != chunk.size() )
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Encodes the remaining output in memory
+     */
+    QByteArray encode()
+    {
+        QByteArray data;
+        while ( !done_ )
+            data += nextChunk();
+        return data;
+    }
+
+private:
+    void writeHeader(QByteArray& chunk, QDataStream& stream)
+    {
+        if ( format_ == Binary )
+        {
+            stream << quint32(binary_magic) << quint16(binary_version)
+                   << qint32(row_count_) << qint32(column_count_);
+        }
+        else if ( format_ == Html )
+        {
+            chunk += "<html><head><meta charset=\"utf-8\"/></head><body><table>\n";
+        }
+    }
+
+    void writeRow(QByteArray& chunk, QDataStream& stream, int row)
+    {
+        if ( format_ == Html )
+            chunk += "<tr>";
+
+        for ( int column = 0; column < column_count_; column++ )
+        {
+            QVariant value = model_->data(model_->index(row_ + row, column_ + column, parent_));
+            switch ( format_ )
+            {
+                case Binary:
+                    stream << value;
+                    break;
+                case Html:
+                    chunk += "<td>";
+                    chunk += value.toString().toHtmlEscaped().toUtf8();
+                    chunk += "</td>";
+                    break;
+                case Tsv:
+                    if ( column > 0 )
+                        chunk += '\t';
+                    // TSV has no escaping, separators in values become spaces
+                    chunk += value.toString()
+                        .replace(QLatin1Char('\t'), QLatin1Char(' '))
+                        .replace(QLatin1Char('\n'), QLatin1Char(' ')).toUtf8();
+                    break;
+            }
+        }
+
+        if ( format_ == Html )
+            chunk += "</tr>\n";
+        else if ( format_ == Tsv )
+            chunk += '\n';
+    }
+
+    const Model* model_;
+    Format format_;
+    int row_;
+    int column_;
+    int row_count_;
+    int column_count_;
+    Index parent_;
+    int chunk_rows_;
+    int next_row_ = 0;
+    bool started_ = false;
+    bool done_ = false;
+};
+
+/**
+ * \brief Mime data for a range of items, encoded only when requested
+ *
+ * Nothing is serialized when copying or starting a drag, each format
+ * is encoded the first time it is retrieved (eg: on paste) and cached.
+ * If the model has been destroyed in the meantime, no data is provided.
+ */
+class ModelMimeData : public QMimeData
+{
+public:
+    ModelMimeData(const Model* model, int row, int column,
+                  int row_count, int column_count, const Index& parent = {})
+        : model_(model),
+          row_(row),
+          column_(column),
+          row_count_(row_count),
+          column_count_(column_count),
+          parent_(parent)
+    {}
+
+    QStringList formats() const override
+    {
+        return QStringList{
+            MimeEncoder::mimeType(MimeEncoder::Binary),
+            MimeEncoder::mimeType(MimeEncoder::Tsv),
+            MimeEncoder::mimeType(MimeEncoder::Html),
+            QStringLiteral("text/plain"),
+        };
+    }
+
+    bool hasFormat(const QString& mime_type) const override
+    {
+        return formats().contains(mime_type);
+    }
+
+protected:
+    QVariant retrieveData(const QString& mime_type, QVariant::Type type) const override
+    {
+        MimeEncoder::Format format;
+        if ( !model_ || !MimeEncoder::format(mime_type, format) )
+            return QMimeData::retrieveData(mime_type, type);
+
+        QByteArray& data = cache_[format];
+        if ( data.isEmpty() )
+            data = MimeEncoder(model_, format, row_, column_,
+                               row_count_, column_count_, parent_).encode();
+        return data;
+    }
+
+private:
+    QPointer<const Model> model_;
+    int row_;
+    int column_;
+    int row_count_;
+    int column_count_;
+    Index parent_;
+    mutable QByteArray cache_[3];
+};
+
+/**
+ * \brief Decodes pasted or dropped data in a background thread
+ *
+ * The bytes are copied from the QMimeData in the calling thread,
+ * parsing happens in a worker thread and finished() is emitted from it.
+ * Connect to finished() with the default connection type from a QObject
+ * living in the GUI thread, the decoded values can be accessed from there.
+ */
+class MimeDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~MimeDecoder()
+    {
+        cancel();
+    }
+
+    /**
+     * \brief Starts decoding the best format available in \p data
+     * \returns \b false if \p data has no supported format
+     *
+     * A decoding already in progress is cancelled.
+     */
+    bool decode(const QMimeData* data)
+    {
+        MimeEncoder::Format format;
+        QByteArray bytes;
+        if ( data->hasFormat(MimeEncoder::mimeType(MimeEncoder::Binary)) )
+        {
+            format = MimeEncoder::Binary;
+            bytes = data->data(MimeEncoder::mimeType(MimeEncoder::Binary));
+        }
+        else if ( data->hasFormat(MimeEncoder::mimeType(MimeEncoder::Tsv)) )
+        {
+            format = MimeEncoder::Tsv;
+            bytes = data->data(MimeEncoder::mimeType(MimeEncoder::Tsv));
+        }
+        else if ( data->hasText() )
+        {
+            format = MimeEncoder::Tsv;
+            bytes = data->text().toUtf8();
+        }
+        else
+        {
+            return false;
+        }
+
+        cancel();
+        cancelled_ = false;
+        running_ = true;
+        worker_ = std::thread(&MimeDecoder::run, this, bytes, format);
+        return true;
+    }
+
+    /**
+     * \brief Stops the decoding in progress, if any
+     *
+     * finished() won't be emitted for the cancelled decoding.
+     */
+    void cancel()
+    {
+        cancelled_ = true;
+        if ( worker_.joinable() )
+            worker_.join();
+        running_ = false;
+    }
+
+    /**
+     * \brief Whether a decoding is in progress
+     */
+    bool running() const
+    {
+        return running_;
+    }
+
+    /**
+     * \brief Decoded rows, available after finished()
+     */
+    int rowCount() const
+    {
+        return rows_;
+    }
+
+    /**
+     * \brief Decoded columns, available after finished()
+     */
+    int columnCount() const
+    {
+        return columns_;
+    }
+
+    /**
+     * \brief Decoded value, available after finished()
+     */
+    QVariant value(int row, int column) const
+    {
+        if ( row < 0 || row >= rows_ || column < 0 || column >= columns_ )
+            return QVariant();
+        return values_[row * columns_ + column];
+    }
+
+    /**
+     * \brief Sets the decoded values into \p model starting from \p row, \p column
+     * \returns The number of items that have been set
+     *
+     * Values falling outside the model are skipped.
+     * The changes are applied as a single data batch.
+     */
+    int paste(Model* model, int row, int column, const Index& parent = {}) const
+    {
+        if ( running_ )
+            return 0;
+
+        int rows = std::min(rows_, model->rowCount(parent) - row);
+        int columns = std::min(columns_, model->columnCount(parent) - column);
+        int count = 0;
+
+        model->beginDataBatch();
+        for ( int r = 0; r < rows; r++ )
+            for ( int c = 0; c < columns; c++ )
+                count += model->setData(model->index(row + r, column + c, parent),
+                                        values_[r * columns_ + c]);
+        model->endDataBatch();
+
+        return count;
+    }
+
+signals:
+    /**
+     * \brief Emitted from the worker thread when decoding is complete
+     */
+    void finished();
+
+private:
+    void run(QByteArray bytes, MimeEncoder::Format format)
+    {
+        int rows = 0;
+        int columns = 0;
+        std::vector<QVariant> values;
+
+        bool ok = format == MimeEncoder::Binary ?
+            decodeBinary(bytes, rows, columns, values) :
+            decodeTsv(bytes, rows, columns, values);
+
+        if ( !ok || cancelled_ )
+            rows = columns = 0;
+
+        rows_ = rows;
+        columns_ = columns;
+        values_ = std::move(values);
+        running_ = false;
+
+        if ( !cancelled_ )
+            emit finished();
+    }
+
+    bool decodeBinary(const QByteArray& bytes, int& rows, int& columns,
+                      std::vector<QVariant>& values) const
+    {
+        QDataStream stream(bytes);
+        stream.setVersion(QDataStream::Qt_5_0);
+
+        quint32 magic = 0;
+        quint16 version = 0;
+        qint32 row_count = 0;
+        qint32 column_count = 0;
+        stream >> magic >> version >> row_count >> column_count;
+        if ( magic != quint32(MimeEncoder::binary_magic) ||
+             version != MimeEncoder::binary_version ||
+             row_count < 0 || column_count < 0 )
+            return false;
+
+        // Each value takes at least a byte, larger sizes can't be right
+        // and would only throw bad_alloc in the decoding thread
+        qint64 count = qint64(row_count) * column_count;
+        if ( count > bytes.size() )
+            return false;
+
+        rows = row_count;
+        columns = column_count;
+        values.resize(count);
+        for ( qint64 i = 0; i < count && !cancelled_; i++ )
+        {
+            stream >> values[i];
+            if ( stream.status() != QDataStream::Ok )
+                return false;
+        }
+
+        return stream.status() == QDataStream::Ok;
+    }
+
+    bool decodeTsv(const QByteArray& bytes, int& rows, int& columns,
+                   std::vector<QVariant>& values) const
+    {
+        std::vector<QStringList> lines;
+        for ( int start = 0; start < bytes.size() && !cancelled_; )
+        {
+            int end = bytes.indexOf('\n', start);
+            if ( end == -1 )
+                end = bytes.size();
+            int length = end - start;
+            if ( length > 0 && bytes[end - 1] == '\r' )
+                length--;
+            lines.push_back(QString::fromUtf8(bytes.constData() + start, length)
+                            .split(QLatin1Char('\t')));
+            columns = std::max(columns, int(lines.back().size()));
+            start = end + 1;
+        }
+
+        rows = lines.size();
+        values.resize(qint64(rows) * columns);
+        for ( int row = 0; row < rows; row++ )
+            for ( int column = 0; column < lines[row].size(); column++ )
+                values[qint64(row) * columns + column] = lines[row][column];
+
+        return true;
+    }
+
+    std::thread worker_;
+    std::atomic<bool> cancelled_{false};
+    std::atomic<bool> running_{false};
+    int rows_ = 0;
+    int columns_ = 0;
+    std::vector<QVariant> values_;
+};
+
+} // namespace imv
+#endif // IMV_MIME_DATA_HPP
@@ -21,9 +21,16 @@
 #ifndef IMV_MODEL_HPP
 #define IMV_MODEL_HPP
 
+#include <algorithm>
 #include <QObject>
+#include <QSharedData>
+#include <QThread>
 #include <QVariant>
+#include <QVector>
 #include "data_role.hpp"
+#include "bitmap.hpp"
+#include "small_vector.hpp"
+#include "interval_tree.hpp"
 
 namespace imv {
 
@@ -146,6 +153,162 @@ private:
     const Model* model_ = nullptr;
 };
 
+/**
+ * \brief Receives the notifications of a Model without going through Qt signals
+ *
+ * Observers are called directly by the model, before the matching signal
+ * is emitted, so caches and indexes are up to date when widgets react.
+ * The callbacks mirror the model signals and do nothing by default.
+ *
+ * \see Model::addObserver()
+ */
+class ModelObserver
+{
+public:
+    virtual ~ModelObserver(){}
+
+    virtual void dataChanged(const Index& index, const QVariant& value, int role) {}
+    virtual void dataRangeChanged(int row, int column, int row_count, int column_count,
+                                  const Index& parent, int role) {}
+    virtual void rowsRemoved(int row, int count, const Index& parent) {}
+    virtual void rowsAdded(int row, int count, const Index& parent) {}
+    virtual void rowsShifted(int removed, int added, const Index& parent) {}
+    virtual void columnsRemoved(int column, int count, const Index& parent) {}
+    virtual void columnsAdded(int column, int count, const Index& parent) {}
+    virtual void rowsMoved(const Index& from_parent, int from_row, int count,
+                           const Index& to_parent, int to_row) {}
+    virtual void columnsMoved(const Index& from_parent, int from_column, int count,
+                              const Index& to_parent, int to_column) {}
+    virtual void modelAboutToReset() {}
+    virtual void modelReset() {}
+    virtual void layoutAboutToChange(const Index& parent) {}
+    virtual void layoutChanged(const Index& parent, const QVector<int>& permutation) {}
+};
+
+/**
+ * \brief Rectangle of items under the same parent, and the roles of interest
+ *
+ * \see Model::subscribe()
+ */
+struct ModelRegion
+{
+    ModelRegion() = default;
+
+    ModelRegion(const Index& parent, int row, int row_count, int column,
+                int column_count, quint64 roles = ~quint64(0))
+        : parent(parent), row(row), row_count(row_count),
+          column(column), column_count(column_count), roles(roles)
+    {}
+
+    /**
+     * \brief Bit representing \p role in \p roles, roles from 63 up share the last bit
+     */
+    static quint64 roleBit(int role)
+    {
+        return quint64(1) << std::min(std::max(role, 0), 63);
+    }
+
+    /**
+     * \brief Whether the region overlaps the given columns under \p parent for \p role
+     *
+     * A \p role of -1 stands for any role.
+     */
+    bool matches(const Index& parent, int column, int column_count, int role) const
+    {
+        return parent == this->parent &&
+               column < this->column + this->column_count &&
+               column + column_count > this->column &&
+               (role == -1 ? roles != 0 : (roles & roleBit(role)) != 0);
+    }
+
+    Index parent;
+    int row = 0;
+    int row_count = 0;
+    int column = 0;
+    int column_count = 0;
+    quint64 roles = ~quint64(0);
+};
+
+/**
+ * \brief Batch of data changes, shared between copies
+ *
+ * Copying a ChangeSet only copies a pointer, adding changes detaches it
+ * from the other copies. Once posted with Model::postChanges() a set can
+ * be read from any thread without locking.
+ */
+class ChangeSet
+{
+public:
+    /**
+     * \brief Item changed to \p value for \p role
+     */
+    struct Item
+    {
+        Index index;
+        QVariant value;
+        int role;
+    };
+
+    /**
+     * \brief Rectangle of items under \p parent changed for \p role, -1 for several roles
+     */
+    struct Range
+    {
+        Index parent;
+        int row;
+        int column;
+        int row_count;
+        int column_count;
+        int role;
+    };
+
+    ChangeSet()
+        : d_(new Data)
+    {}
+
+    void addItem(const Index& index, const QVariant& value, int role = Value)
+    {
+        d_->items.append(Item{index, value, role});
+    }
+
+    void addRange(int row, int column, int row_count, int column_count,
+                  const Index& parent = {}, int role = Value)
+    {
+        d_->ranges.append(Range{parent, row, column, row_count, column_count, role});
+    }
+
+    const QVector<Item>& items() const
+    {
+        return d_->items;
+    }
+
+    const QVector<Range>& ranges() const
+    {
+        return d_->ranges;
+    }
+
+    bool isEmpty() const
+    {
+        return d_->items.isEmpty() && d_->ranges.isEmpty();
+    }
+
+private:
+    struct Data : public QSharedData
+    {
+        QVector<Item> items;
+        QVector<Range> ranges;
+    };
+
+    QSharedDataPointer<Data> d_;
+};
+
+} // namespace imv
+
+Q_DECLARE_METATYPE(imv::Index)
+Q_DECLARE_METATYPE(imv::ChangeSet)
+
+namespace imv {
+
 /**
  * \brief Base class for index models
  */
@@ -165,8 +328,32 @@ private:
     };
 
 public:
+    Model()
+    {
+        registerMetaTypes();
+    }
+
     virtual ~Model(){}
 
+    /**
+     * \brief Registers the types used by the model signals with Qt
+     *
+     * Needed for queued connections, it's called by the Model constructor
+     * so signals can be connected across threads without any setup.
+     */
+    static void registerMetaTypes()
+    {
+        static bool registered = []{
+            qRegisterMetaType<Index>("Index");
+            qRegisterMetaType<Index>("imv::Index");
+            qRegisterMetaType<ChangeSet>("ChangeSet");
+            qRegisterMetaType<ChangeSet>("imv::ChangeSet");
+            qRegisterMetaType<QVector<int>>("QVector<int>");
+            return true;
+        }();
+        Q_UNUSED(registered);
+    }
+
     /**
      * \brief Number of rows at the given parent
      */
@@ -204,9 +391,10 @@ public:
      */
     bool valid(const Index& index) const
     {
-        auto par = parent(index);
-        return index.model() == this &&
-               validRow(index.row(), par) &&
+        if ( index.model() != this )
+            return false;
+        auto par = onParent(index);
+        return validRow(index.row(), par) &&
                validColumn(index.column(), par) &&
                onValid(index);
     }
@@ -233,6 +421,7 @@ public:
      * \brief Returns the data associated with the item index for the given role
      * \returns An empty variant if the index or role are invalid or don't
      *          have any data to report
+     * \see isNull()
      */
     QVariant data(const Index& index, int role = Value) const
     {
@@ -241,22 +430,257 @@ public:
         return onData(index, role);
     }
 
+    /**
+     * \brief Whether the item has no data for the given role
+     *
+     * Cheaper than checking the result of data() as models can
+     * answer without constructing a QVariant.
+     */
+    bool isNull(const Index& index, int role = Value) const
+    {
+        if ( !valid(index) )
+            return true;
+        return onIsNull(index, role);
+    }
+
+    /**
+     * \brief Bitmap with a bit set for each item without a Value
+     * \param column  Column to inspect
+     * \param row     First row to inspect
+     * \param count   Number of rows
+     * \param parent  Parent of the rows
+     * \returns An empty bitmap if the range is invalid
+     */
+    Bitmap nullMask(int column, int row, int count, const Index& parent = {}) const
+    {
+        if ( count < 0 || row < 0 || row + count > rowCount(parent) ||
+             column < 0 || column >= columnCount(parent) )
+            return Bitmap();
+        return onNullMask(column, row, count, parent);
+    }
+
+    /**
+     * \brief Data for a range of rows in a column
+     * \param column  Column to read
+     * \param row     First row to read
+     * \param count   Number of rows
+     * \param parent  Parent of the rows
+     * \param role    Role to read
+     * \returns An empty vector if the range is invalid
+     *
+     * Models with expensive access can fetch the whole range at once.
+     */
+    QVector<QVariant> dataRange(int column, int row, int count,
+                                const Index& parent = {}, int role = Value) const
+    {
+        if ( count < 0 || row < 0 || row + count > rowCount(parent) ||
+             column < 0 || column >= columnCount(parent) )
+            return QVector<QVariant>();
+        return onDataRange(column, row, count, parent, role);
+    }
+
     /**
      * \brief Sets data for the item
      * \returns \b true on success
      *
-     * Emits dataChanged() on success.
+     * Emits dataChanged() on success, unless inside a data batch or a reset.
+     * \see beginDataBatch()
      */
     bool setData(const Index& index, const QVariant& value, int role = Value)
     {
         if ( valid(index) && onSetData(index, value, role) )
         {
-            emit dataChanged(index, value, role);
+            itemChanged(index, value, role);
             return true;
         }
         return false;
     }
 
+    /**
+     * \brief Starts collecting changes made by setData()
+     *
+     * Until the matching endDataBatch(), setData() won't emit dataChanged()
+     * and the changed items are collected in a single range instead.
+     * Batches can be nested.
+     */
+    void beginDataBatch()
+    {
+        batch_.depth++;
+    }
+
+    /**
+     * \brief Ends a batch started with beginDataBatch()
+     *
+     * When the outermost batch ends, emits dataRangeChanged() with the
+     * bounding range of the changed items.
+     */
+    void endDataBatch()
+    {
+        if ( batch_.depth > 0 && --batch_.depth == 0 )
+            flushBatch();
+    }
+
+    /**
+     * \brief Begins replacing the whole contents of the model
+     *
+     * Emits modelAboutToReset(). Until the matching endReset(), changes
+     * made through the model functions don't emit any signal, so a reload
+     * doesn't notify every row it touches. Resets can be nested.
+     */
+    void beginReset()
+    {
+        if ( reset_depth_++ == 0 )
+            notifyModelAboutToReset();
+    }
+
+    /**
+     * \brief Ends a reset started with beginReset()
+     *
+     * When the outermost reset ends, emits modelReset(). Listeners should
+     * drop anything they know about the model and read it again.
+     */
+    void endReset()
+    {
+        if ( reset_depth_ > 0 && --reset_depth_ == 0 )
+        {
+            batch_.empty = true;
+            notifyModelReset();
+        }
+    }
+
+    /**
+     * \brief Whether the model is between beginReset() and endReset()
+     */
+    bool resetting() const
+    {
+        return reset_depth_ > 0;
+    }
+
+    /**
+     * \brief Begins reordering the rows under \p parent
+     *
+     * Emits layoutAboutToChange(). The rows can be shuffled but not added
+     * or removed until the matching endLayoutChange().
+     */
+    void beginLayoutChange(const Index& parent = {})
+    {
+        if ( reset_depth_ == 0 )
+            notifyLayoutAboutToChange(parent);
+    }
+
+    /**
+     * \brief Ends a reordering started with beginLayoutChange()
+     * \param parent      Parent of the reordered rows
+     * \param permutation New row for each old row, empty if not known
+     *
+     * Emits layoutChanged().
+     */
+    void endLayoutChange(const Index& parent = {}, const QVector<int>& permutation = {})
+    {
+        if ( reset_depth_ == 0 )
+            notifyLayoutChanged(parent, permutation);
+    }
+
+    /**
+     * \brief Notifies a batch of data changes, can be called from any thread
+     *
+     * From a thread other than the model's, the set is handed to the model
+     * thread through a queued call, copying only its shared pointer. There
+     * each item is notified as dataChanged() and each range as
+     * dataRangeChanged(), then changesPosted() is emitted with the whole set.
+     *
+     * The model may have changed shape before the set is delivered: items
+     * no longer valid are skipped and ranges are clipped to the current
+     * row and column counts.
+     */
+    void postChanges(const ChangeSet& changes)
+    {
+        if ( QThread::currentThread() == thread() )
+            deliverChanges(changes);
+        else
+            QMetaObject::invokeMethod(this, [this, changes]{ deliverChanges(changes); },
+                                      Qt::QueuedConnection);
+    }
+
+    /**
+     * \brief Registers \p observer to be notified of the changes to the model
+     *
+     * The model doesn't take ownership, the observer must be removed before
+     * being destroyed. Observers can't be added or removed from within their
+     * callbacks.
+     */
+    void addObserver(ModelObserver* observer)
+    {
+        if ( observer && observers_.indexOf(observer) == -1 )
+            observers_.push_back(observer);
+    }
+
+    void removeObserver(ModelObserver* observer)
+    {
+        int index = observers_.indexOf(observer);
+        if ( index != -1 )
+            observers_.erase(index);
+    }
+
+    /**
+     * \brief Notifies \p observer of the data changes touching \p region
+     * \returns An id for setSubscriptionRegion() and unsubscribe()
+     *
+     * dataChanged() and dataRangeChanged() are delivered only if they
+     * intersect the region, the other notifications are always delivered.
+     * The region isn't moved when rows or columns are added or removed.
+     * An observer with several subscriptions receives each change once per
+     * matching region. An observer also registered with addObserver()
+     * already receives everything, its subscriptions are ignored until it's
+     * removed. Subscriptions can't be changed from within observer callbacks.
+     */
+    int subscribe(ModelObserver* observer, const ModelRegion& region)
+    {
+        if ( !observer )
+            return -1;
+        int id = next_subscription_++;
+        subscriptions_.insert(region.row, region.row + region.row_count,
+                              Subscription{id, observer, region});
+
+        int index = subscriberIndex(observer);
+        if ( index == -1 )
+            subscribers_.push_back(Subscriber{observer, 1});
+        else
+            subscribers_[index].subscriptions++;
+        return id;
+    }
+
+    /**
+     * \brief Moves a subscription to a different region, eg: when a view scrolls
+     * \returns \b false if \p id isn't a subscription
+     *
+     * Finding the subscription is linear, small scrolls are then updated in
+     * place without sorting the subscriptions again.
+     */
+    bool setSubscriptionRegion(int id, const ModelRegion& region)
+    {
+        return subscriptions_.update(
+            [id](const Subscription& subscription) { return subscription.id == id; },
+            region.row, region.row + region.row_count,
+            [&region](Subscription& subscription) { subscription.region = region; }
+        );
+    }
+
+    void unsubscribe(int id)
+    {
+        ModelObserver* observer = nullptr;
+        subscriptions_.removeIf([id, &observer](const Subscription& subscription) {
+            if ( subscription.id != id )
+                return false;
+            observer = subscription.observer;
+            return true;
+        });
+
+        int index = subscriberIndex(observer);
+        if ( index != -1 && --subscribers_[index].subscriptions == 0 )
+            subscribers_.erase(index);
+    }
+
     /**
      * \brief Returns the parent for that index
      */
@@ -267,6 +691,34 @@ public:
         return onParent(index);
     }
 
+    /**
+     * \brief Inserts a single row
+     * \see insertRows
+     */
+    bool insertRow(int row, const Index& parent = {})
+    {
+        return insertRows(row, 1, parent);
+    }
+
+    /**
+     * \brief Inserts some empty rows before \p row
+     * \returns \b true on success
+     *
+     * Emits rowsAdded() on success when this
+     * isn't being done while moving rows.
+     */
+    bool insertRows(int row, int count, const Index& parent = {})
+    {
+        if ( count > 0 && validRow(row, parent) &&
+            onInsertRows(row, count, parent) )
+        {
+            if ( !(moving_ & Rows) && reset_depth_ == 0 )
+                notifyRowsAdded(row, count, parent);
+            return true;
+        }
+        return false;
+    }
+
     /**
      * \brief Removes a single row
      * \see removeRows
@@ -288,8 +740,8 @@ public:
         if ( count > 0 && validRow(row, parent) && validRow(row+count-1, parent)
                 && onRemoveRows(row, count, parent) )
         {
-            if ( !(moving_ & Rows) )
-                emit rowsRemoved(row, count, parent);
+            if ( !(moving_ & Rows) && reset_depth_ == 0 )
+                notifyRowsRemoved(row, count, parent);
             return true;
         }
         return false;
@@ -317,8 +769,8 @@ public:
             validColumn(column+count-1, parent) &&
             onRemoveColumns(column, count, parent) )
         {
-            if ( !(moving_ & Columns) )
-                emit columnsRemoved(column, count, parent);
+            if ( !(moving_ & Columns) && reset_depth_ == 0 )
+                notifyColumnsRemoved(column, count, parent);
             return true;
         }
         return false;
@@ -349,6 +801,7 @@ public:
             beginMoveRows();
             bool ok = onMoveRows(from_parent, from_row, count, to_parent, to_row);
             endMoveRows(ok, from_parent, from_row, count, to_parent, to_row);
+            return ok;
         }
         return false;
     }
@@ -379,6 +832,7 @@ public:
             beginMoveColumns();
             bool ok = onMoveColumns(from_parent, from_column, count, to_parent, to_column);
             endMoveColumns(ok, from_parent, from_column, count, to_parent, to_column);
+            return ok;
         }
         return false;
     }
@@ -415,6 +869,54 @@ protected:
         return createIndex(row, column, 0);
     }
 
+    /**
+     * \brief Whether the item has no data for \p role
+     * \param index A valid index
+     */
+    virtual bool onIsNull(const Index& index, int role) const
+    {
+        return !onData(index, role).isValid();
+    }
+
+    /**
+     * \brief Builds the null bitmap for a range of rows in a column
+     * \param column  A valid column in \p parent
+     * \param row     A valid row in \p parent
+     * \param count   Number of rows, already checked that they are all valid in \p parent
+     * \param parent  Parent of the rows
+     */
+    virtual Bitmap onNullMask(int column, int row, int count, const Index& parent) const
+    {
+        Bitmap mask(count);
+        for ( int i = 0; i < count; i++ )
+        {
+            Index index = onIndex(row + i, column, parent);
+            mask.set(i, !index.valid() || onIsNull(index, Value));
+        }
+        return mask;
+    }
+
+    /**
+     * \brief Reads the data for a range of rows in a column
+     * \param column  A valid column in \p parent
+     * \param row     A valid row in \p parent
+     * \param count   Number of rows, already checked that they are all valid in \p parent
+     * \param parent  Parent of the rows
+     * \param role    Role to read
+     */
+    virtual QVector<QVariant> onDataRange(int column, int row, int count,
+                                          const Index& parent, int role) const
+    {
+        QVector<QVariant> values;
+        values.reserve(count);
+        for ( int i = 0; i < count; i++ )
+        {
+            Index index = onIndex(row + i, column, parent);
+            values.append(index.valid() ? onData(index, role) : QVariant());
+        }
+        return values;
+    }
+
     /**
      * \brief Set the data to its destination
      * \param index A valid index in the model
@@ -448,13 +950,25 @@ protected:
 
     /**
      * \brief Returns the parent of \p index
-     * \param index A valid index in the model
+     * \param index An index belonging to the model, used by valid()
+     *              so its row and column haven't been checked yet
      */
     virtual Index onParent(const Index& index) const
     {
         return {};
     }
 
+    /**
+     * \brief Inserts some empty rows in the model
+     * \param row    Row in \p parent, rowCount(parent) to append
+     * \param count  Number of rows to insert
+     * \param parent Parent index to insert into
+     */
+    virtual bool onInsertRows(int row, int count, const Index& parent)
+    {
+        return false;
+    }
+
     /**
      * \brief Removes some rows from the model
      * \param row    A valid row in \p parent
@@ -559,8 +1073,8 @@ protected:
                      const Index& to_parent, int to_row)
     {
         moving_ &= ~Rows;
-        if ( ok )
-            emit rowsMoved(from_parent, from_row, count, to_parent, to_row);
+        if ( ok && reset_depth_ == 0 )
+            notifyRowsMoved(from_parent, from_row, count, to_parent, to_row);
     }
 
     /**
@@ -584,21 +1098,372 @@ protected:
                         int count, const Index& to_parent, int to_column)
     {
         moving_ &= ~Columns;
-        if ( ok )
-            emit columnsMoved(from_parent, from_column, count, to_parent, to_column);
+        if ( ok && reset_depth_ == 0 )
+            notifyColumnsMoved(from_parent, from_column, count, to_parent, to_column);
+    }
+
+    /**
+     * \brief Reports a change made outside setData()
+     *
+     * Like setData(), it's silent during a reset and collected into the
+     * current data batch, if any.
+     */
+    void itemChanged(const Index& index, const QVariant& value, int role)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        if ( batch_.depth > 0 )
+            addToBatch(onParent(index), index.row(), index.column(),
+                       index.row(), index.column(), role);
+        else
+            notifyDataChanged(index, value, role);
+    }
+
+    /**
+     * \brief Reports a range changed outside setData(), see itemChanged()
+     */
+    void rangeChanged(int row, int column, int row_count, int column_count,
+                      const Index& parent, int role)
+    {
+        if ( reset_depth_ > 0 || row_count <= 0 || column_count <= 0 )
+            return;
+        if ( batch_.depth > 0 )
+            addToBatch(parent, row, column, row + row_count - 1,
+                       column + column_count - 1, role);
+        else
+            notifyDataRangeChanged(row, column, row_count, column_count, parent, role);
+    }
+
+    /*
+     * Notifications: each calls the observers and then emits the matching
+     * signal. Subclasses should use them instead of emitting the signals.
+     * Between beginReset() and endReset() all but the reset ones are silent.
+     */
+    void notifyDataChanged(const Index& index, const QVariant& value, int role)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        for ( ModelObserver* observer : observers_ )
+            observer->dataChanged(index, value, role);
+        if ( !subscriptions_.empty() )
+        {
+            Index parent = onParent(index);
+            subscriptions_.query(index.row(), index.row() + 1,
+                [&](const Subscription& subscription) {
+                    if ( subscription.region.matches(parent, index.column(), 1, role) &&
+                         !isObserver(subscription.observer) )
+                        subscription.observer->dataChanged(index, value, role);
+                });
+        }
+        emit dataChanged(index, value, role);
+    }
+
+    void notifyDataRangeChanged(int row, int column, int row_count, int column_count,
+                                const Index& parent, int role)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        for ( ModelObserver* observer : observers_ )
+            observer->dataRangeChanged(row, column, row_count, column_count, parent, role);
+        subscriptions_.query(row, row + row_count, [&](const Subscription& subscription) {
+            if ( subscription.region.matches(parent, column, column_count, role) &&
+                 !isObserver(subscription.observer) )
+                subscription.observer->dataRangeChanged(row, column, row_count,
+                                                        column_count, parent, role);
+        });
+        emit dataRangeChanged(row, column, row_count, column_count, parent, role);
+    }
+
+    void notifyRowsRemoved(int row, int count, const Index& parent)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->rowsRemoved(row, count, parent);
+        });
+        emit rowsRemoved(row, count, parent);
+    }
+
+    void notifyRowsAdded(int row, int count, const Index& parent)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->rowsAdded(row, count, parent);
+        });
+        emit rowsAdded(row, count, parent);
+    }
+
+    void notifyRowsShifted(int removed, int added, const Index& parent)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->rowsShifted(removed, added, parent);
+        });
+        emit rowsShifted(removed, added, parent);
+    }
+
+    void notifyColumnsRemoved(int column, int count, const Index& parent)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->columnsRemoved(column, count, parent);
+        });
+        emit columnsRemoved(column, count, parent);
+    }
+
+    void notifyColumnsAdded(int column, int count, const Index& parent)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->columnsAdded(column, count, parent);
+        });
+        emit columnsAdded(column, count, parent);
+    }
+
+    void notifyRowsMoved(const Index& from_parent, int from_row, int count,
+                         const Index& to_parent, int to_row)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->rowsMoved(from_parent, from_row, count, to_parent, to_row);
+        });
+        emit rowsMoved(from_parent, from_row, count, to_parent, to_row);
+    }
+
+    void notifyColumnsMoved(const Index& from_parent, int from_column, int count,
+                            const Index& to_parent, int to_column)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->columnsMoved(from_parent, from_column, count, to_parent, to_column);
+        });
+        emit columnsMoved(from_parent, from_column, count, to_parent, to_column);
+    }
+
+    void notifyModelAboutToReset()
+    {
+        forEachObserver([&](ModelObserver* observer) {
+            observer->modelAboutToReset();
+        });
+        emit modelAboutToReset();
+    }
+
+    void notifyModelReset()
+    {
+        forEachObserver([&](ModelObserver* observer) {
+            observer->modelReset();
+        });
+        emit modelReset();
+    }
+
+    void notifyLayoutAboutToChange(const Index& parent)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->layoutAboutToChange(parent);
+        });
+        emit layoutAboutToChange(parent);
+    }
+
+    void notifyLayoutChanged(const Index& parent, const QVector<int>& permutation)
+    {
+        if ( reset_depth_ > 0 )
+            return;
+        forEachObserver([&](ModelObserver* observer) {
+            observer->layoutChanged(parent, permutation);
+        });
+        emit layoutChanged(parent, permutation);
     }
 
 signals:
     void dataChanged(const Index& index, const QVariant& value, int role);
+    /**
+     * \brief Emitted at the end of a data batch
+     *
+     * \p role is -1 if items have been changed for several roles.
+     * If the batch touched items with different parents, this is emitted
+     * once for each run of changes under the same parent.
+     */
+    void dataRangeChanged(int row, int column, int row_count, int column_count,
+                          const Index& parent, int role);
     void rowsRemoved(int row, int count, const Index& parent);
     void rowsAdded(int row, int count, const Index& parent);
+    /**
+     * \brief Emitted when \p removed rows left the top of \p parent and
+     *        \p added rows were appended at the bottom, in a single step
+     *
+     * Stands for rowsRemoved(0, removed) followed by rowsAdded() at the end,
+     * without the intermediate state, as in a sliding window.
+     */
+    void rowsShifted(int removed, int added, const Index& parent);
     void columnsRemoved(int column, int count, const Index& parent);
     void columnsAdded(int row, int count, const Index& parent);
     void rowsMoved(const Index& from_parent, int from_row, int count, const Index& to_parent, int to_row);
     void columnsMoved(const Index& from_parent, int from_column, int count, const Index& to_parent, int to_column);
+    /**
+     * \brief Emitted by beginReset(), the model is still in its old state
+     */
+    void modelAboutToReset();
+    /**
+     * \brief Emitted by endReset(), everything about the model may have changed
+     */
+    void modelReset();
+    /**
+     * \brief Emitted before the rows under \p parent are reordered
+     */
+    void layoutAboutToChange(const Index& parent);
+    /**
+     * \brief Emitted after the rows under \p parent have been reordered
+     *
+     * If \p permutation isn't empty, the row which was at \p i is now at
+     * \p permutation[i]. Otherwise listeners should forget the row order.
+     */
+    void layoutChanged(const Index& parent, const QVector<int>& permutation);
+    /**
+     * \brief Emitted after the changes in \p changes have been notified one by one
+     *
+     * Listeners in other threads receive the shared set, not a copy.
+     */
+    void changesPosted(const ChangeSet& changes);
 
 private:
-    bool moving_ = Nothing;
+    void deliverChanges(const ChangeSet& changes)
+    {
+        if ( reset_depth_ > 0 || changes.isEmpty() )
+            return;
+        for ( const ChangeSet::Item& item : changes.items() )
+        {
+            if ( valid(item.index) )
+                notifyDataChanged(item.index, item.value, item.role);
+        }
+        for ( const ChangeSet::Range& range : changes.ranges() )
+        {
+            if ( range.parent.valid() && !valid(range.parent) )
+                continue;
+            int row = std::max(range.row, 0);
+            int column = std::max(range.column, 0);
+            int row_count = std::min(range.row + range.row_count, rowCount(range.parent)) - row;
+            int column_count = std::min(range.column + range.column_count,
+                                        columnCount(range.parent)) - column;
+            if ( row_count > 0 && column_count > 0 )
+                notifyDataRangeChanged(row, column, row_count, column_count,
+                                       range.parent, range.role);
+        }
+        emit changesPosted(changes);
+    }
+
+    struct Subscription
+    {
+        int id;
+        ModelObserver* observer;
+        ModelRegion region;
+    };
+
+    /**
+     * \brief Observer with region subscriptions, listed once however many it has
+     */
+    struct Subscriber
+    {
+        ModelObserver* observer;
+        int subscriptions;
+    };
+
+    int subscriberIndex(ModelObserver* observer) const
+    {
+        for ( int i = 0; i < subscribers_.size(); i++ )
+            if ( subscribers_[i].observer == observer )
+                return i;
+        return -1;
+    }
+
+    /**
+     * \brief Whether \p observer was added with addObserver()
+     */
+    bool isObserver(ModelObserver* observer) const
+    {
+        return observers_.indexOf(observer) != -1;
+    }
+
+    /**
+     * \brief Calls \p func once for each observer and subscriber
+     */
+    template<class Func>
+        void forEachObserver(const Func& func)
+        {
+            for ( ModelObserver* observer : observers_ )
+                func(observer);
+            for ( const Subscriber& subscriber : subscribers_ )
+            {
+                if ( !isObserver(subscriber.observer) )
+                    func(subscriber.observer);
+            }
+        }
+
+    /**
+     * \brief Bounding range of the items changed in the current data batch
+     */
+    struct DataBatch
+    {
+        int depth = 0;
+        bool empty = true;
+        Index parent;
+        int top = 0;
+        int left = 0;
+        int bottom = 0;
+        int right = 0;
+        int role = 0;
+    };
+
+    void addToBatch(const Index& parent, int top, int left, int bottom, int right, int role)
+    {
+        if ( !batch_.empty && parent != batch_.parent )
+            flushBatch();
+
+        if ( batch_.empty )
+        {
+            batch_.empty = false;
+            batch_.parent = parent;
+            batch_.top = top;
+            batch_.bottom = bottom;
+            batch_.left = left;
+            batch_.right = right;
+            batch_.role = role;
+            return;
+        }
+
+        batch_.top = std::min(batch_.top, top);
+        batch_.bottom = std::max(batch_.bottom, bottom);
+        batch_.left = std::min(batch_.left, left);
+        batch_.right = std::max(batch_.right, right);
+        if ( batch_.role != role )
+            batch_.role = -1;
+    }
+
+    void flushBatch()
+    {
+        if ( batch_.empty )
+            return;
+        batch_.empty = true;
+        notifyDataRangeChanged(batch_.top, batch_.left,
+                               batch_.bottom - batch_.top + 1,
+                               batch_.right - batch_.left + 1,
+                               batch_.parent, batch_.role);
+    }
+
+    int moving_ = Nothing;
+    DataBatch batch_;
+    int reset_depth_ = 0;
+    SmallVector<ModelObserver*, 4> observers_;
+    IntervalTree<Subscription> subscriptions_;
+    SmallVector<Subscriber, 4> subscribers_;
+    int next_subscription_ = 0;
 };
 
 
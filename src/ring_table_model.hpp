@@ -0,0 +1,234 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_RING_TABLE_MODEL_HPP
+#define IMV_RING_TABLE_MODEL_HPP
+
+#include <algorithm>
+#include <vector>
+#include <QVector>
+#include "model.hpp"
+
+namespace imv {
+
+/**
+ * \brief Flat model keeping the last rows appended, up to a fixed capacity
+ *
+ * Rows live in a circular buffer allocated once, logical rows are mapped
+ * to physical slots through the offset of the oldest row. When the model
+ * is full, appending overwrites the oldest slot and moves the offset,
+ * nothing is shifted in memory.
+ *
+ * Appending to a full model shifts all the logical rows up, the oldest
+ * rows leaving at the top and the new ones entering at the bottom.
+ * This is notified with a single rowsShifted(), so views can scroll
+ * instead of repainting every row; appendedRows() tells by how many rows
+ * the window has moved.
+ */
+class RingTableModel : public Model
+{
+public:
+    typedef QVector<QVariant> Row;
+
+    /**
+     * \param capacity      Maximum number of rows
+     * \param column_count  Number of columns of each row
+     */
+    RingTableModel(int capacity, int column_count)
+        : capacity_(std::max(capacity, 1)),
+          column_count_(std::max(column_count, 0)),
+          slots_(std::size_t(capacity_) * column_count_)
+    {}
+
+    int capacity() const
+    {
+        return capacity_;
+    }
+
+    bool full() const
+    {
+        return size_ == capacity_;
+    }
+
+    /**
+     * \brief Total number of rows appended, including the overwritten ones
+     */
+    qint64 appendedRows() const
+    {
+        return appended_;
+    }
+
+    /**
+     * \brief Physical slot holding the logical \p row
+     */
+    int physicalRow(int row) const
+    {
+        int slot = head_ + row;
+        return slot >= capacity_ ? slot - capacity_ : slot;
+    }
+
+    /**
+     * \brief Appends a row, overwriting the oldest one if the model is full
+     *
+     * Values past columnCount() are ignored.
+     */
+    void append(const Row& row)
+    {
+        int old_size = size_;
+        write(row);
+        appended_++;
+        notifyAppended(old_size, 1);
+    }
+
+    /**
+     * \brief Appends several rows with a single notification
+     *
+     * Emits rowsShifted() if old rows have been overwritten, rowsAdded()
+     * otherwise.
+     */
+    void append(const QVector<Row>& rows)
+    {
+        if ( rows.isEmpty() )
+            return;
+
+        int old_size = size_;
+        // Older rows would be overwritten by the later ones anyway
+        int first = std::max(0, rows.size() - capacity_);
+        for ( int i = first; i < rows.size(); i++ )
+            write(rows[i]);
+        appended_ += rows.size();
+        notifyAppended(old_size, rows.size());
+    }
+
+    /**
+     * \brief Removes all the rows, keeping the allocated slots
+     */
+    void clear()
+    {
+        int old_size = size_;
+        std::fill(slots_.begin(), slots_.end(), QVariant());
+        head_ = 0;
+        size_ = 0;
+        if ( old_size )
+            notifyRowsRemoved(0, old_size, Index());
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : size_;
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : column_count_;
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < size_ && index.column() < column_count_;
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return QVariant();
+        return slots_[slot(index.row(), index.column())];
+    }
+
+    QVector<QVariant> onDataRange(int column, int row, int count,
+                                  const Index& parent, int role) const override
+    {
+        QVector<QVariant> values;
+        values.reserve(count);
+        int physical = physicalRow(row);
+        for ( int i = 0; i < count; i++ )
+        {
+            values.append(role == Value ? slots_[std::size_t(physical) * column_count_ + column] : QVariant());
+            if ( ++physical == capacity_ )
+                physical = 0;
+        }
+        return values;
+    }
+
+    bool onSetData(const Index& index, const QVariant& value, int role) override
+    {
+        if ( role != Value )
+            return false;
+        slots_[slot(index.row(), index.column())] = value;
+        return true;
+    }
+
+private:
+    std::size_t slot(int row, int column) const
+    {
+        return std::size_t(physicalRow(row)) * column_count_ + column;
+    }
+
+    /**
+     * \brief Emits the signals for \p count rows appended when there were \p old_size
+     */
+    void notifyAppended(int old_size, int count)
+    {
+        // Old rows pushed out at the top, the rest has shifted up
+        int evicted = std::min(old_size, old_size + count - size_);
+        int added = size_ - (old_size - evicted);
+        if ( evicted > 0 )
+            notifyRowsShifted(evicted, added, Index());
+        else if ( added > 0 )
+            notifyRowsAdded(old_size, added, Index());
+    }
+
+    /**
+     * \brief Stores \p row after the last one, without notifying
+     */
+    void write(const Row& row)
+    {
+        int physical;
+        if ( size_ < capacity_ )
+        {
+            physical = physicalRow(size_);
+            size_++;
+        }
+        else
+        {
+            physical = head_;
+            if ( ++head_ == capacity_ )
+                head_ = 0;
+        }
+
+        auto out = slots_.begin() + std::size_t(physical) * column_count_;
+        int copied = std::min(row.size(), column_count_);
+        std::copy(row.begin(), row.begin() + copied, out);
+        std::fill(out + copied, out + column_count_, QVariant());
+    }
+
+    int capacity_;
+    int column_count_;
+    /// capacity_ rows of column_count_ values
+    std::vector<QVariant> slots_;
+    /// Physical slot of the oldest row
+    int head_ = 0;
+    int size_ = 0;
+    qint64 appended_ = 0;
+};
+
+} // namespace imv
+#endif // IMV_RING_TABLE_MODEL_HPP
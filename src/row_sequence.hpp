@@ -0,0 +1,463 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_ROW_SEQUENCE_HPP
+#define IMV_ROW_SEQUENCE_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace imv {
+
+/**
+ * \brief Sequence of rows stored in small blocks
+ *
+ * The blocks are the leaves of a B+tree whose nodes hold the number of rows
+ * below them. Finding a row takes O(log n), inserting or removing k rows
+ * only shifts the elements of the blocks involved and touches O(log n)
+ * nodes for each block added or removed, so structural changes cost
+ * O(log n + k). Consecutive accesses to the same block skip the search.
+ */
+template<class T, class Allocator = std::allocator<T>>
+class RowSequence
+{
+public:
+    enum
+    {
+        default_block_size = 512,
+        branching = 16 ///< Maximum number of children of an inner node
+    };
+
+    /**
+     * \param block_size Preferred number of elements in each block
+     * \param allocator  Allocator used for the block storage
+     */
+    explicit RowSequence(int block_size = default_block_size,
+                         const Allocator& allocator = Allocator())
+        : block_size_(std::max(block_size, 1)),
+          allocator_(allocator)
+    {}
+
+    int size() const
+    {
+        return root_ ? root_->size : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * \brief Number of blocks currently in use
+     */
+    int blockCount() const
+    {
+        return leaves_;
+    }
+
+    const T& operator[](int row) const
+    {
+        int offset;
+        Node* leaf = locate(row, offset);
+        return leaf->values[offset];
+    }
+
+    T& operator[](int row)
+    {
+        int offset;
+        Node* leaf = locate(row, offset);
+        return leaf->values[offset];
+    }
+
+    /**
+     * \brief Inserts \p count copies of \p value before \p row
+     */
+    void insert(int row, int count, const T& value = T())
+    {
+        std::vector<T> values(count, value);
+        insert(row, values.begin(), values.end());
+    }
+
+    /**
+     * \brief Inserts a range of values before \p row
+     */
+    template<class Iterator>
+        void insert(int row, Iterator first, Iterator last)
+        {
+            int count = std::distance(first, last);
+            if ( count <= 0 )
+                return;
+
+            if ( !root_ )
+                root_.reset(newLeaf());
+
+            int offset;
+            Node* leaf = locate(row, offset);
+            cached_leaf_ = nullptr;
+            Block& values = leaf->values;
+
+            if ( int(values.size()) + count <= 2 * block_size_ )
+            {
+                values.insert(values.begin() + offset, first, last);
+                addSize(leaf, count);
+                return;
+            }
+
+            // Split the leaf around the insertion point and add new leaves
+            std::vector<Block> blocks;
+            Block tail(std::make_move_iterator(values.begin() + offset),
+                       std::make_move_iterator(values.end()), allocator_);
+            addSize(leaf, offset - int(values.size()));
+            values.erase(values.begin() + offset, values.end());
+            appendChunked(blocks, first, last);
+            if ( !tail.empty() )
+                blocks.push_back(std::move(tail));
+
+            auto block = blocks.begin();
+            if ( values.empty() )
+            {
+                values.swap(*block++);
+                addSize(leaf, values.size());
+            }
+            for ( ; block != blocks.end(); ++block )
+            {
+                Node* next = newLeaf();
+                next->values.swap(*block);
+                next->size = next->values.size();
+                insertAfter(leaf, next);
+                leaf = next;
+            }
+        }
+
+    /**
+     * \brief Removes \p count elements starting from \p row
+     */
+    void erase(int row, int count)
+    {
+        if ( count <= 0 )
+            return;
+
+        int offset;
+        Node* leaf = locate(row, offset);
+        cached_leaf_ = nullptr;
+
+        while ( count > 0 )
+        {
+            Block& values = leaf->values;
+            int removed = std::min<int>(count, values.size() - offset);
+            values.erase(values.begin() + offset, values.begin() + offset + removed);
+            addSize(leaf, -removed);
+            count -= removed;
+            offset = 0;
+
+            Node* next = count > 0 ? nextLeaf(leaf) : nullptr;
+            if ( values.empty() )
+                remove(leaf);
+            leaf = next;
+        }
+
+        // Merge small neighbours so the number of blocks stays bounded
+        if ( row > 0 && row < size() )
+        {
+            Node* before = locate(row - 1, offset);
+            Node* after = nextLeaf(before);
+            cached_leaf_ = nullptr;
+            if ( after && before->size + after->size <= block_size_ )
+            {
+                int moved = after->size;
+                before->values.insert(before->values.end(),
+                                      std::make_move_iterator(after->values.begin()),
+                                      std::make_move_iterator(after->values.end()));
+                addSize(before, moved);
+                addSize(after, -moved);
+                remove(after);
+            }
+        }
+    }
+
+    /**
+     * \brief Moves \p count elements starting from \p row before \p to_row
+     *
+     * \p to_row is expressed in the coordinates before the move.
+     */
+    void move(int row, int count, int to_row)
+    {
+        if ( to_row >= row && to_row <= row + count )
+            return;
+
+        std::vector<T> moved;
+        moved.reserve(count);
+        int offset;
+        Node* leaf = locate(row, offset);
+        for ( int copied = 0; copied < count; leaf = nextLeaf(leaf), offset = 0 )
+        {
+            Block& values = leaf->values;
+            int chunk = std::min<int>(count - copied, values.size() - offset);
+            std::move(values.begin() + offset, values.begin() + offset + chunk,
+                      std::back_inserter(moved));
+            copied += chunk;
+        }
+
+        erase(row, count);
+        insert(to_row > row ? to_row - count : to_row,
+               std::make_move_iterator(moved.begin()),
+               std::make_move_iterator(moved.end()));
+    }
+
+    void clear()
+    {
+        root_.reset();
+        leaves_ = 0;
+        cached_leaf_ = nullptr;
+    }
+
+private:
+    typedef std::vector<T, Allocator> Block;
+
+    struct Node
+    {
+        Node(bool leaf, const Allocator& allocator)
+            : leaf(leaf), values(allocator)
+        {}
+
+        bool leaf;
+        Node* parent = nullptr;
+        /// Number of elements in the subtree
+        int size = 0;
+        /// Children of inner nodes
+        std::vector<std::unique_ptr<Node>> children;
+        /// Elements of a leaf
+        Block values;
+    };
+
+    /**
+     * \brief Finds the leaf containing \p row
+     * \param[out] offset   Position of \p row inside the leaf
+     *
+     * \p row can be size(), which gives the end of the last leaf.
+     */
+    Node* locate(int row, int& offset) const
+    {
+        if ( cached_leaf_ && row >= cached_start_ &&
+             row < cached_start_ + cached_leaf_->size )
+        {
+            offset = row - cached_start_;
+            return cached_leaf_;
+        }
+
+        Node* node = root_.get();
+        int remaining = row;
+        while ( !node->leaf )
+        {
+            std::size_t child = 0;
+            while ( child + 1 < node->children.size() &&
+                    remaining >= node->children[child]->size )
+                remaining -= node->children[child++]->size;
+            node = node->children[child].get();
+        }
+
+        offset = remaining;
+        cached_leaf_ = node;
+        cached_start_ = row - remaining;
+        return node;
+    }
+
+    Node* newLeaf()
+    {
+        leaves_++;
+        return new Node(true, allocator_);
+    }
+
+    static int childIndex(const Node* node)
+    {
+        const auto& siblings = node->parent->children;
+        int index = 0;
+        while ( siblings[index].get() != node )
+            index++;
+        return index;
+    }
+
+    /**
+     * \brief Leaf after \p node, null for the last one
+     */
+    static Node* nextLeaf(Node* node)
+    {
+        for ( ; node->parent; node = node->parent )
+        {
+            const auto& siblings = node->parent->children;
+            std::size_t index = childIndex(node) + 1;
+            if ( index < siblings.size() )
+            {
+                node = siblings[index].get();
+                while ( !node->leaf )
+                    node = node->children.front().get();
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * \brief Adds \p delta to the size of \p node and its ancestors
+     */
+    static void addSize(Node* node, int delta)
+    {
+        for ( ; node; node = node->parent )
+            node->size += delta;
+    }
+
+    /**
+     * \brief Adds \p next as the sibling following \p node, splitting full nodes
+     */
+    void insertAfter(Node* node, Node* next)
+    {
+        Node* parent = node->parent;
+        if ( !parent )
+        {
+            // Splitting the root, the tree grows a level
+            parent = new Node(false, allocator_);
+            parent->size = node->size;
+            parent->children.emplace_back(root_.release());
+            node->parent = parent;
+            root_.reset(parent);
+        }
+
+        auto& children = parent->children;
+        next->parent = parent;
+        children.emplace(children.begin() + childIndex(node) + 1, next);
+        addSize(parent, next->size);
+
+        if ( int(children.size()) > branching )
+        {
+            Node* half = new Node(false, allocator_);
+            for ( auto child = children.begin() + children.size() / 2; child != children.end(); ++child )
+            {
+                (*child)->parent = half;
+                half->size += (*child)->size;
+                half->children.push_back(std::move(*child));
+            }
+            children.resize(children.size() - half->children.size());
+            addSize(parent, -half->size);
+            insertAfter(parent, half);
+        }
+    }
+
+    /**
+     * \brief Destroys \p node, merging or refilling inner nodes left with few children
+     */
+    void remove(Node* node)
+    {
+        if ( node->leaf )
+            leaves_--;
+
+        Node* parent = node->parent;
+        if ( !parent )
+        {
+            root_.reset();
+            return;
+        }
+
+        addSize(parent, -node->size);
+        parent->children.erase(parent->children.begin() + childIndex(node));
+        rebalance(parent);
+    }
+
+    void rebalance(Node* node)
+    {
+        Node* parent = node->parent;
+        if ( !parent )
+        {
+            // Roots with a single child are dropped
+            if ( node->children.size() == 1 )
+            {
+                std::unique_ptr<Node> child = std::move(node->children.front());
+                child->parent = nullptr;
+                root_ = std::move(child);
+            }
+            return;
+        }
+
+        if ( int(node->children.size()) >= branching / 2 )
+            return;
+
+        int index = childIndex(node);
+        Node* left = index > 0 ? parent->children[index - 1].get() : node;
+        Node* right = index > 0 ? node : parent->children[index + 1].get();
+
+        if ( int(left->children.size() + right->children.size()) <= branching )
+        {
+            for ( auto& child : right->children )
+            {
+                child->parent = left;
+                left->size += child->size;
+                left->children.push_back(std::move(child));
+            }
+            right->children.clear();
+            right->size = 0;
+            remove(right);
+        }
+        else if ( node == left )
+        {
+            std::unique_ptr<Node> child = std::move(right->children.front());
+            right->children.erase(right->children.begin());
+            right->size -= child->size;
+            left->size += child->size;
+            child->parent = left;
+            left->children.push_back(std::move(child));
+        }
+        else
+        {
+            std::unique_ptr<Node> child = std::move(left->children.back());
+            left->children.pop_back();
+            left->size -= child->size;
+            right->size += child->size;
+            child->parent = right;
+            right->children.insert(right->children.begin(), std::move(child));
+        }
+    }
+
+    /**
+     * \brief Appends the values to \p blocks in blocks of block_size_
+     */
+    template<class Iterator>
+        void appendChunked(std::vector<Block>& blocks, Iterator first, Iterator last)
+        {
+            while ( first != last )
+            {
+                blocks.emplace_back(allocator_);
+                blocks.back().reserve(block_size_);
+                for ( int i = 0; i < block_size_ && first != last; i++, ++first )
+                    blocks.back().push_back(*first);
+            }
+        }
+
+    std::unique_ptr<Node> root_;
+    int block_size_;
+    Allocator allocator_;
+    int leaves_ = 0;
+    mutable Node* cached_leaf_ = nullptr;
+    mutable int cached_start_ = 0;
+};
+
+} // namespace imv
+#endif // IMV_ROW_SEQUENCE_HPP
@@ -0,0 +1,155 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_SMALL_VECTOR_HPP
+#define IMV_SMALL_VECTOR_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace imv {
+
+/**
+ * \brief Vector storing up to \p N elements inline, without allocating
+ *
+ * Meant for short lists of trivially copyable values, like pointers.
+ * Past \p N elements, they are moved to the heap.
+ */
+template<class T, int N>
+    class SmallVector
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "SmallVector only holds trivially copyable types");
+
+    public:
+        SmallVector() = default;
+
+        SmallVector(const SmallVector& other)
+        {
+            *this = other;
+        }
+
+        SmallVector& operator=(const SmallVector& other)
+        {
+            if ( this != &other )
+            {
+                clear();
+                reserve(other.size_);
+                std::memcpy(data(), other.data(), other.size_ * sizeof(T));
+                size_ = other.size_;
+            }
+            return *this;
+        }
+
+        ~SmallVector()
+        {
+            delete[] heap_;
+        }
+
+        int size() const
+        {
+            return size_;
+        }
+
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        T* data()
+        {
+            return heap_ ? heap_ : inline_;
+        }
+
+        const T* data() const
+        {
+            return heap_ ? heap_ : inline_;
+        }
+
+        T* begin() { return data(); }
+        T* end() { return data() + size_; }
+        const T* begin() const { return data(); }
+        const T* end() const { return data() + size_; }
+
+        T& operator[](int i)
+        {
+            return data()[i];
+        }
+
+        const T& operator[](int i) const
+        {
+            return data()[i];
+        }
+
+        void push_back(const T& value)
+        {
+            if ( size_ == capacity_ )
+                reserve(capacity_ * 2);
+            data()[size_++] = value;
+        }
+
+        /**
+         * \brief Removes the element at \p i, keeping the order of the others
+         */
+        void erase(int i)
+        {
+            T* items = data();
+            std::memmove(items + i, items + i + 1, (size_ - i - 1) * sizeof(T));
+            size_--;
+        }
+
+        /**
+         * \brief Index of the first element equal to \p value, -1 if not found
+         */
+        int indexOf(const T& value) const
+        {
+            const T* iter = std::find(begin(), end(), value);
+            return iter == end() ? -1 : iter - begin();
+        }
+
+        /**
+         * \brief Removes all the elements, keeping the allocated storage
+         */
+        void clear()
+        {
+            size_ = 0;
+        }
+
+        void reserve(int capacity)
+        {
+            if ( capacity <= capacity_ )
+                return;
+            T* heap = new T[capacity];
+            std::memcpy(heap, data(), size_ * sizeof(T));
+            delete[] heap_;
+            heap_ = heap;
+            capacity_ = capacity;
+        }
+
+    private:
+        T inline_[N];
+        T* heap_ = nullptr;
+        int size_ = 0;
+        int capacity_ = N;
+    };
+
+} // namespace imv
+#endif // IMV_SMALL_VECTOR_HPP
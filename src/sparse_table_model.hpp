@@ -0,0 +1,226 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_SPARSE_TABLE_MODEL_HPP
+#define IMV_SPARSE_TABLE_MODEL_HPP
+
+#include <numeric>
+#include <vector>
+#include <QHash>
+#include "model.hpp"
+#include "column.hpp"
+
+namespace imv {
+
+/**
+ * \brief Flat model which only stores the items that have a value
+ *
+ * Cells are stored in hash tables keyed by stable row and column ids,
+ * logical positions are mapped to ids through plain arrays. This way
+ * structural changes only shift the id arrays and never rehash cells.
+ */
+class SparseTableModel : public Model
+{
+public:
+    explicit SparseTableModel(int rows = 0, int columns = 0)
+    {
+        insertIds(row_ids_, next_row_id_, 0, rows);
+        insertIds(column_ids_, next_column_id_, 0, columns);
+    }
+
+    /**
+     * \brief Number of items with a value
+     */
+    int cellCount() const
+    {
+        int count = 0;
+        for ( const auto& row : cells_ )
+            count += row.size();
+        return count;
+    }
+
+    /**
+     * \brief Inserts \p count empty columns before \p column
+     *
+     * Emits columnsAdded().
+     */
+    bool insertColumns(int column, int count)
+    {
+        if ( count <= 0 || column < 0 || column > int(column_ids_.size()) )
+            return false;
+        insertIds(column_ids_, next_column_id_, column, count);
+        notifyColumnsAdded(column, count, Index());
+        return true;
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : row_ids_.size();
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : column_ids_.size();
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < int(row_ids_.size()) &&
+               index.column() < int(column_ids_.size());
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return QVariant();
+        auto row = cells_.constFind(row_ids_[index.row()]);
+        if ( row == cells_.constEnd() )
+            return QVariant();
+        return row->value(column_ids_[index.column()]);
+    }
+
+    bool onIsNull(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return true;
+        auto row = cells_.constFind(row_ids_[index.row()]);
+        return row == cells_.constEnd() || !row->contains(column_ids_[index.column()]);
+    }
+
+    Bitmap onNullMask(int column, int row, int count, const Index& parent) const override
+    {
+        Bitmap mask(count, true);
+        int column_id = column_ids_[column];
+        for ( int i = 0; i < count; i++ )
+        {
+            auto cells = cells_.constFind(row_ids_[row + i]);
+            if ( cells != cells_.constEnd() && cells->contains(column_id) )
+                mask.set(i, false);
+        }
+        return mask;
+    }
+
+    bool onSetData(const Index& index, const QVariant& value, int role) override
+    {
+        if ( role != Value )
+            return false;
+
+        int row_id = row_ids_[index.row()];
+        if ( value.isValid() )
+        {
+            cells_[row_id].insert(column_ids_[index.column()], value);
+        }
+        else
+        {
+            auto row = cells_.find(row_id);
+            if ( row != cells_.end() )
+            {
+                row->remove(column_ids_[index.column()]);
+                if ( row->isEmpty() )
+                    cells_.erase(row);
+            }
+        }
+        return true;
+    }
+
+    bool onInsertRows(int row, int count, const Index& parent) override
+    {
+        if ( parent.valid() )
+            return false;
+        insertIds(row_ids_, next_row_id_, row, count);
+        return true;
+    }
+
+    bool onRemoveRows(int row, int count, const Index& parent) override
+    {
+        if ( parent.valid() || row + count > int(row_ids_.size()) )
+            return false;
+        for ( int i = row; i < row + count; i++ )
+            cells_.remove(row_ids_[i]);
+        row_ids_.erase(row_ids_.begin() + row, row_ids_.begin() + row + count);
+        return true;
+    }
+
+    bool onMoveRows(const Index& from_parent, int from_row, int count,
+                    const Index& to_parent, int to_row) override
+    {
+        int size = row_ids_.size();
+        if ( from_parent.valid() || to_parent.valid() ||
+             from_row + count > size || to_row < 0 || to_row > size ||
+             (to_row >= from_row && to_row <= from_row + count) )
+            return false;
+        detail::moveRange(row_ids_, from_row, count, to_row);
+        return true;
+    }
+
+    bool onRemoveColumns(int column, int count, const Index& parent) override
+    {
+        if ( parent.valid() || column + count > int(column_ids_.size()) )
+            return false;
+
+        for ( auto row = cells_.begin(); row != cells_.end(); )
+        {
+            for ( int i = column; i < column + count; i++ )
+                row->remove(column_ids_[i]);
+            if ( row->isEmpty() )
+                row = cells_.erase(row);
+            else
+                ++row;
+        }
+
+        column_ids_.erase(column_ids_.begin() + column,
+                          column_ids_.begin() + column + count);
+        return true;
+    }
+
+    bool onMoveColumns(const Index& from_parent, int from_column, int count,
+                       const Index& to_parent, int to_column) override
+    {
+        int size = column_ids_.size();
+        if ( from_parent.valid() || to_parent.valid() ||
+             from_column + count > size || to_column < 0 || to_column > size ||
+             (to_column >= from_column && to_column <= from_column + count) )
+            return false;
+        detail::moveRange(column_ids_, from_column, count, to_column);
+        return true;
+    }
+
+private:
+    /**
+     * \brief Inserts \p count new ids before \p position
+     */
+    static void insertIds(std::vector<int>& ids, int& next_id, int position, int count)
+    {
+        auto iter = ids.insert(ids.begin() + position, count, 0);
+        std::iota(iter, iter + count, next_id);
+        next_id += count;
+    }
+
+    /// Row id -> (column id -> value)
+    QHash<int, QHash<int, QVariant>> cells_;
+    std::vector<int> row_ids_;
+    std::vector<int> column_ids_;
+    int next_row_id_ = 0;
+    int next_column_id_ = 0;
+};
+
+} // namespace imv
+#endif // IMV_SPARSE_TABLE_MODEL_HPP
@@ -0,0 +1,612 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_SQLITE_TABLE_MODEL_HPP
+#define IMV_SQLITE_TABLE_MODEL_HPP
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <vector>
+#include <QHash>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include "model.hpp"
+
+namespace imv {
+
+/**
+ * \brief Flat model showing the rows of an SQLite table
+ *
+ * The row count is a cached \c COUNT(*), items are read from a small window
+ * of pages. Each page is fetched with a single prepared statement which
+ * starts from the sort key of the last row of a previous page (keyset
+ * pagination), so scrolling doesn't make SQLite skip over all the rows
+ * before the page. Sorting and filtering are done by the query.
+ *
+ * setData() updates the cached page right away and queues the write,
+ * queued writes are committed in a single transaction once control
+ * returns to the event loop (or by submit()).
+ *
+ * Rows are identified by \c rowid, so the table can't be \c WITHOUT \c ROWID.
+ * Changes to the sorted or filtered columns don't move rows until they are
+ * committed, which refreshes the model. setFilter() takes the columns the
+ * filter reads, as the condition is arbitrary SQL.
+ */
+class SqliteTableModel : public Model
+{
+public:
+    /**
+     * \param database      Open SQLite connection
+     * \param table         Name of the table to show
+     * \param page_size     Number of rows fetched by each query
+     * \param window_pages  Number of pages kept in memory
+     */
+    SqliteTableModel(const QSqlDatabase& database, const QString& table,
+                     int page_size = 256, int window_pages = 8)
+        : database_(database),
+          table_(table),
+          page_size_(std::max(page_size, 1)),
+          window_pages_(std::max(window_pages, 1))
+    {
+        QSqlRecord record = database_.record(table_);
+        for ( int i = 0; i < record.count(); i++ )
+            columns_.append(record.fieldName(i));
+
+        write_timer_.setSingleShot(true);
+        write_timer_.setInterval(write_delay_);
+        connect(&write_timer_, &QTimer::timeout, this, [this]{ submit(); });
+
+        prepareQueries();
+        count_ = queryCount();
+    }
+
+    /**
+     * \brief Writes the queued changes, without refreshing or notifying
+     */
+    ~SqliteTableModel()
+    {
+        write_timer_.stop();
+        bool moved = false;
+        writePending(moved);
+    }
+
+    /**
+     * \brief Name of the table being shown
+     */
+    QString tableName() const
+    {
+        return table_;
+    }
+
+    /**
+     * \brief Name of the table column shown at \p column
+     */
+    QString columnName(int column) const
+    {
+        return columns_.value(column);
+    }
+
+    /**
+     * \brief Sorts by \p column, -1 sorts by \c rowid
+     */
+    void setSort(int column, Qt::SortOrder order = Qt::AscendingOrder)
+    {
+        submit();
+        sort_column_ = column >= 0 && column < columns_.size() ? column : -1;
+        sort_order_ = order;
+        beginReset();
+        prepareQueries();
+        refresh();
+        endReset();
+    }
+
+    int sortColumn() const
+    {
+        return sort_column_;
+    }
+
+    Qt::SortOrder sortOrder() const
+    {
+        return sort_order_;
+    }
+
+    /**
+     * \brief Only shows the rows matching \p condition
+     * \param condition SQL expression used in the \c WHERE clause,
+     *                  empty to show all the rows
+     * \param values    Values bound to the \c ? placeholders in \p condition
+     * \param columns   Columns read by \p condition, committing a write to
+     *                  them refreshes the model. If empty, any write does.
+     */
+    void setFilter(const QString& condition, const QVariantList& values = {},
+                   const QVector<int>& columns = {})
+    {
+        submit();
+        filter_ = condition;
+        filter_values_ = values;
+        filter_columns_ = columns;
+        beginReset();
+        prepareQueries();
+        refresh();
+        endReset();
+    }
+
+    QString filter() const
+    {
+        return filter_;
+    }
+
+    /**
+     * \brief Counts the rows again and drops the cached pages
+     *
+     * Resets the model.
+     */
+    void refresh()
+    {
+        beginReset();
+        clearPages();
+        count_ = queryCount();
+        endReset();
+    }
+
+    /**
+     * \brief The \c rowid of \p row, -1 if it can't be read
+     */
+    qint64 rowId(int row) const
+    {
+        if ( row < 0 || row >= count_ )
+            return -1;
+        const Page* page = fetchPage(row / page_size_);
+        int offset = row % page_size_;
+        return page && offset < int(page->rowids.size()) ? page->rowids[offset] : -1;
+    }
+
+    /**
+     * \brief Milliseconds queued writes wait for more writes before being committed
+     */
+    void setWriteDelay(int msec)
+    {
+        write_delay_ = std::max(msec, 0);
+        write_timer_.setInterval(write_delay_);
+    }
+
+    int writeDelay() const
+    {
+        return write_delay_;
+    }
+
+    /**
+     * \brief Number of items changed but not yet written to the database
+     */
+    int pendingWrites() const
+    {
+        int count = 0;
+        for ( const auto& row : pending_ )
+            count += row.size();
+        return count;
+    }
+
+    /**
+     * \brief Writes all the queued changes in a single transaction
+     * \returns \b false if the transaction failed, the changes are kept queued
+     *
+     * If any of the changes is to the sorted or filtered columns, rows may
+     * have moved or left the filter and the model is refreshed.
+     */
+    bool submit()
+    {
+        write_timer_.stop();
+        bool moved = false;
+        if ( !writePending(moved) )
+            return false;
+        if ( moved )
+            refresh();
+        return true;
+    }
+
+    /**
+     * \brief Last error reported by the database
+     */
+    QSqlError lastError() const
+    {
+        return last_error_;
+    }
+
+    /**
+     * \brief Number of pages currently in memory
+     */
+    int cachedPages() const
+    {
+        return pages_.size();
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : count_;
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : columns_.size();
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < count_ && index.column() < columns_.size();
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return QVariant();
+
+        const Page* page = fetchPage(index.row() / page_size_);
+        int offset = index.row() % page_size_;
+        if ( !page || offset >= int(page->rowids.size()) )
+            return QVariant();
+        return page->values[offset * columns_.size() + index.column()];
+    }
+
+    QVector<QVariant> onDataRange(int column, int row, int count,
+                                  const Index& parent, int role) const override
+    {
+        QVector<QVariant> values;
+        values.reserve(count);
+        for ( int i = row; i < row + count; )
+        {
+            int offset = i % page_size_;
+            int chunk = std::min(page_size_ - offset, row + count - i);
+            const Page* page = role == Value ? fetchPage(i / page_size_) : nullptr;
+            for ( int j = offset; j < offset + chunk; j++ )
+            {
+                if ( page && j < int(page->rowids.size()) )
+                    values.append(page->values[j * columns_.size() + column]);
+                else
+                    values.append(QVariant());
+            }
+            i += chunk;
+        }
+        return values;
+    }
+
+    bool onSetData(const Index& index, const QVariant& value, int role) override
+    {
+        if ( role != Value )
+            return false;
+
+        Page* page = fetchPage(index.row() / page_size_);
+        int offset = index.row() % page_size_;
+        if ( !page || offset >= int(page->rowids.size()) )
+            return false;
+
+        page->values[offset * columns_.size() + index.column()] = value;
+        pending_[page->rowids[offset]][index.column()] = value;
+        if ( !write_timer_.isActive() )
+            write_timer_.start();
+        return true;
+    }
+
+private:
+    struct Page
+    {
+        std::vector<qint64> rowids;
+        /// Row-major, columns_.size() values per row
+        std::vector<QVariant> values;
+    };
+
+    /**
+     * \brief Sort key of the last row before a page
+     */
+    struct Boundary
+    {
+        QVariant sort_value;
+        qint64 rowid;
+    };
+
+    static QString quoted(const QString& identifier)
+    {
+        return '"' + QString(identifier).replace('"', QStringLiteral("\"\"")) + '"';
+    }
+
+    /**
+     * \brief Builds the statements for the current sorting and filter
+     *
+     * All of them bind the filter values first, the page queries end
+     * with \c LIMIT and \c OFFSET.
+     */
+    void prepareQueries()
+    {
+        clearPages();
+
+        QStringList fields;
+        fields << QStringLiteral("rowid");
+        for ( const QString& column : columns_ )
+            fields << quoted(column);
+
+        QString from = QStringLiteral(" FROM ") + quoted(table_);
+        QString where = filter_.isEmpty() ? QString() : '(' + filter_ + ')';
+        QString select = QStringLiteral("SELECT ") + fields.join(QStringLiteral(", ")) + from;
+
+        bool ascending = sort_order_ == Qt::AscendingOrder;
+        QString order = ascending ? QStringLiteral(" ASC") : QStringLiteral(" DESC");
+        QString sort = sort_column_ < 0 ? QString() : quoted(columns_[sort_column_]);
+        QString order_by = sort_column_ < 0 ?
+            QStringLiteral(" ORDER BY rowid") + order :
+            QStringLiteral(" ORDER BY ") + sort + order + QStringLiteral(", rowid ASC");
+        QString limit = QStringLiteral(" LIMIT ? OFFSET ?");
+
+        // SQLite sorts nulls first, keys after a null boundary need their own condition
+        QString after, after_null;
+        if ( sort_column_ < 0 )
+        {
+            after = ascending ? QStringLiteral("rowid > ?") : QStringLiteral("rowid < ?");
+        }
+        else if ( ascending )
+        {
+            after = QStringLiteral("(%1 > ? OR (%1 = ? AND rowid > ?))").arg(sort);
+            after_null = QStringLiteral("(%1 IS NOT NULL OR rowid > ?)").arg(sort);
+        }
+        else
+        {
+            after = QStringLiteral("(%1 < ? OR (%1 = ? AND rowid > ?) OR %1 IS NULL)").arg(sort);
+            after_null = QStringLiteral("(%1 IS NULL AND rowid > ?)").arg(sort);
+        }
+
+        auto where_and = [&where](const QString& condition) {
+            return QStringLiteral(" WHERE ") +
+                (where.isEmpty() ? condition : where + QStringLiteral(" AND ") + condition);
+        };
+
+        count_query_ = prepare(QStringLiteral("SELECT COUNT(*)") + from +
+            (where.isEmpty() ? QString() : QStringLiteral(" WHERE ") + where));
+        start_query_ = prepare(select +
+            (where.isEmpty() ? QString() : QStringLiteral(" WHERE ") + where) +
+            order_by + limit);
+        after_query_ = prepare(select + where_and(after) + order_by + limit);
+        if ( !after_null.isEmpty() )
+            after_null_query_ = prepare(select + where_and(after_null) + order_by + limit);
+    }
+
+    QSqlQuery prepare(const QString& sql)
+    {
+        QSqlQuery query(database_);
+        query.setForwardOnly(true);
+        if ( !query.prepare(sql) )
+            last_error_ = query.lastError();
+        return query;
+    }
+
+    QSqlQuery& updateQuery(int column)
+    {
+        auto iter = updates_.find(column);
+        if ( iter == updates_.end() )
+            iter = updates_.insert(column, prepare(
+                QStringLiteral("UPDATE %1 SET %2 = ? WHERE rowid = ?")
+                .arg(quoted(table_), quoted(columns_[column]))));
+        return *iter;
+    }
+
+    int bindFilter(QSqlQuery& query) const
+    {
+        for ( int i = 0; i < filter_values_.size(); i++ )
+            query.bindValue(i, filter_values_[i]);
+        return filter_values_.size();
+    }
+
+    bool fail(const QSqlError& error) const
+    {
+        last_error_ = error;
+        return false;
+    }
+
+    int queryCount()
+    {
+        bindFilter(count_query_);
+        if ( !count_query_.exec() )
+        {
+            fail(count_query_.lastError());
+            return 0;
+        }
+        int count = count_query_.next() ? count_query_.value(0).toInt() : 0;
+        count_query_.finish();
+        return count;
+    }
+
+    /**
+     * \brief Commits the queued changes in a single transaction
+     * \param moved Set to \b true if a change can move rows, see affectsOrder()
+     * \returns \b false if the transaction failed, the changes are kept queued
+     */
+    bool writePending(bool& moved)
+    {
+        if ( pending_.empty() )
+            return true;
+
+        if ( !database_.transaction() )
+            return fail(database_.lastError());
+
+        for ( auto row = pending_.begin(); row != pending_.end(); ++row )
+        {
+            for ( auto item = row->begin(); item != row->end(); ++item )
+            {
+                moved = moved || affectsOrder(item.key());
+                QSqlQuery& update = updateQuery(item.key());
+                update.bindValue(0, item.value());
+                update.bindValue(1, row.key());
+                if ( !update.exec() )
+                {
+                    QSqlError error = update.lastError();
+                    database_.rollback();
+                    return fail(error);
+                }
+            }
+        }
+
+        if ( !database_.commit() )
+        {
+            QSqlError error = database_.lastError();
+            database_.rollback();
+            return fail(error);
+        }
+
+        pending_.clear();
+        return true;
+    }
+
+    /**
+     * \brief Whether changing \p column can move rows or change the row count
+     */
+    bool affectsOrder(int column) const
+    {
+        if ( column == sort_column_ )
+            return true;
+        if ( filter_.isEmpty() )
+            return false;
+        return filter_columns_.isEmpty() || filter_columns_.contains(column);
+    }
+
+    void clearPages()
+    {
+        pages_.clear();
+        lru_.clear();
+        boundaries_.clear();
+    }
+
+    /**
+     * \brief Returns page \p number, querying it if it isn't in the window
+     */
+    Page* fetchPage(int number) const
+    {
+        auto iter = pages_.find(number);
+        if ( iter != pages_.end() )
+        {
+            lru_.splice(lru_.begin(), lru_, std::find(lru_.begin(), lru_.end(), number));
+            return &*iter;
+        }
+
+        // Start after the closest known key before the page
+        auto boundary = boundaries_.upper_bound(number);
+        QSqlQuery* query = &start_query_;
+        int skip = number * page_size_;
+        int bind = 0;
+        if ( boundary != boundaries_.begin() )
+        {
+            --boundary;
+            const Boundary& key = boundary->second;
+            skip = (number - boundary->first) * page_size_;
+            query = sort_column_ >= 0 && key.sort_value.isNull() ? &after_null_query_ : &after_query_;
+            bind = bindFilter(*query);
+            if ( query == &after_query_ && sort_column_ >= 0 )
+            {
+                query->bindValue(bind++, key.sort_value);
+                query->bindValue(bind++, key.sort_value);
+            }
+            query->bindValue(bind++, key.rowid);
+        }
+        else
+        {
+            bind = bindFilter(*query);
+        }
+        query->bindValue(bind++, page_size_);
+        query->bindValue(bind++, skip);
+
+        if ( !query->exec() )
+        {
+            fail(query->lastError());
+            return nullptr;
+        }
+
+        Page page;
+        QVariant last_key;
+        int columns = columns_.size();
+        page.rowids.reserve(page_size_);
+        page.values.reserve(page_size_ * columns);
+        while ( query->next() )
+        {
+            qint64 rowid = query->value(0).toLongLong();
+            page.rowids.push_back(rowid);
+            auto pending = pending_.find(rowid);
+            for ( int i = 0; i < columns; i++ )
+            {
+                if ( pending != pending_.end() && pending->contains(i) )
+                    page.values.push_back(pending->value(i));
+                else
+                    page.values.push_back(query->value(i + 1));
+            }
+            // The key must match the database, not the pending edits
+            if ( sort_column_ >= 0 )
+                last_key = query->value(sort_column_ + 1);
+        }
+        query->finish();
+
+        // The last row of a full page is where the next one starts from
+        if ( int(page.rowids.size()) == page_size_ )
+            boundaries_[number + 1] = Boundary{last_key, page.rowids.back()};
+
+        if ( int(lru_.size()) >= window_pages_ )
+        {
+            pages_.remove(lru_.back());
+            lru_.pop_back();
+        }
+        lru_.push_front(number);
+        return &*pages_.insert(number, std::move(page));
+    }
+
+    QSqlDatabase database_;
+    QString table_;
+    QStringList columns_;
+    int page_size_;
+    int window_pages_;
+    int count_ = 0;
+
+    int sort_column_ = -1;
+    Qt::SortOrder sort_order_ = Qt::AscendingOrder;
+    QString filter_;
+    QVariantList filter_values_;
+    QVector<int> filter_columns_;
+
+    mutable QSqlQuery count_query_;
+    mutable QSqlQuery start_query_;
+    mutable QSqlQuery after_query_;
+    mutable QSqlQuery after_null_query_;
+    QHash<int, QSqlQuery> updates_;
+
+    mutable QHash<int, Page> pages_;
+    /// Page numbers, most recently used at the front
+    mutable std::list<int> lru_;
+    mutable std::map<int, Boundary> boundaries_;
+
+    /// Queued writes by rowid and column
+    QHash<qint64, QMap<int, QVariant>> pending_;
+    QTimer write_timer_;
+    int write_delay_ = 100;
+    mutable QSqlError last_error_;
+};
+
+} // namespace imv
+#endif // IMV_SQLITE_TABLE_MODEL_HPP
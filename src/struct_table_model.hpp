@@ -0,0 +1,530 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_STRUCT_TABLE_MODEL_HPP
+#define IMV_STRUCT_TABLE_MODEL_HPP
+
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "model.hpp"
+#include "column.hpp"
+
+namespace imv {
+
+/**
+ * \brief Data member \p Member of a record, used as a column of a StructTableModel
+ *
+ * Use IMV_FIELD() instead of spelling the member pointer type.
+ */
+template<class MemberPointer, MemberPointer Member>
+    struct Field;
+
+template<class Record, class T, T Record::*Member>
+    struct Field<T Record::*, Member>
+    {
+        typedef Record record_type;
+        typedef T value_type;
+
+        static const T& get(const Record& record)
+        {
+            return record.*Member;
+        }
+
+        static T& get(Record& record)
+        {
+            return record.*Member;
+        }
+    };
+
+/**
+ * \brief Field for \p member of \p Record, eg: \code IMV_FIELD(Point, x) \endcode
+ */
+#define IMV_FIELD(Record, member) ::imv::Field<decltype(&Record::member), &Record::member>
+
+namespace detail {
+
+template<int... I>
+    struct IndexSequence {};
+
+template<int N, int... I>
+    struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...> {};
+
+template<int... I>
+    struct MakeIndexSequence<0, I...>
+    {
+        typedef IndexSequence<I...> type;
+    };
+
+template<int I, class... T>
+    struct TypeAt;
+
+template<class Head, class... Tail>
+    struct TypeAt<0, Head, Tail...>
+    {
+        typedef Head type;
+    };
+
+template<int I, class Head, class... Tail>
+    struct TypeAt<I, Head, Tail...> : TypeAt<I - 1, Tail...> {};
+
+template<class... Conditions>
+    struct AllOf : std::true_type {};
+
+template<class Head, class... Tail>
+    struct AllOf<Head, Tail...>
+        : std::integral_constant<bool, Head::value && AllOf<Tail...>::value> {};
+
+/**
+ * \brief Expands a pack of expressions, evaluating them in order
+ *
+ * Use as <tt>Expand{(expr, 0)...}</tt>: elements of a braced initializer
+ * list are evaluated left to right, unlike function arguments.
+ */
+struct Expand
+{
+    template<class... Args>
+        Expand(Args&&...) {}
+};
+
+} // namespace detail
+
+/**
+ * \brief Stores the records of a StructTableModel in a single vector
+ */
+template<class Record, class... Fields>
+    class RecordStorage
+    {
+    public:
+        typedef Record record_type;
+
+        int size() const
+        {
+            return records_.size();
+        }
+
+        template<int I>
+            typename detail::TypeAt<I, Fields...>::type::value_type& get(int row)
+            {
+                return detail::TypeAt<I, Fields...>::type::get(records_[row]);
+            }
+
+        template<int I>
+            const typename detail::TypeAt<I, Fields...>::type::value_type& get(int row) const
+            {
+                return detail::TypeAt<I, Fields...>::type::get(records_[row]);
+            }
+
+        Record record(int row) const
+        {
+            return records_[row];
+        }
+
+        void setRecord(int row, const Record& record)
+        {
+            records_[row] = record;
+        }
+
+        void append(const Record& record)
+        {
+            records_.push_back(record);
+        }
+
+        void insert(int row, int count)
+        {
+            records_.insert(records_.begin() + row, count, Record());
+        }
+
+        void remove(int row, int count)
+        {
+            records_.erase(records_.begin() + row, records_.begin() + row + count);
+        }
+
+        void move(int row, int count, int to_row)
+        {
+            detail::moveRange(records_, row, count, to_row);
+        }
+
+        void reserve(int count)
+        {
+            records_.reserve(count);
+        }
+
+    private:
+        std::vector<Record> records_;
+    };
+
+/**
+ * \brief Stores the records of a StructTableModel with a vector for each field
+ *
+ * Scanning a single column only touches its values, but reading a whole
+ * record gathers it from all the vectors.
+ */
+template<class Record, class... Fields>
+    class FieldStorage
+    {
+        typedef typename detail::MakeIndexSequence<sizeof...(Fields)>::type Indices;
+
+    public:
+        typedef Record record_type;
+
+        int size() const
+        {
+            return std::get<0>(columns_).size();
+        }
+
+        template<int I>
+            typename detail::TypeAt<I, Fields...>::type::value_type& get(int row)
+            {
+                return std::get<I>(columns_)[row];
+            }
+
+        template<int I>
+            const typename detail::TypeAt<I, Fields...>::type::value_type& get(int row) const
+            {
+                return std::get<I>(columns_)[row];
+            }
+
+        Record record(int row) const
+        {
+            Record record;
+            read(record, row, Indices());
+            return record;
+        }
+
+        void setRecord(int row, const Record& record)
+        {
+            write(record, row, Indices());
+        }
+
+        void append(const Record& record)
+        {
+            append(record, Indices());
+        }
+
+        void insert(int row, int count)
+        {
+            insert(row, count, Indices());
+        }
+
+        void remove(int row, int count)
+        {
+            remove(row, count, Indices());
+        }
+
+        void move(int row, int count, int to_row)
+        {
+            move(row, count, to_row, Indices());
+        }
+
+        void reserve(int count)
+        {
+            reserve(count, Indices());
+        }
+
+    private:
+        template<int... I>
+            void read(Record& record, int row, detail::IndexSequence<I...>) const
+            {
+                detail::Expand{(Fields::get(record) = get<I>(row), 0)...};
+            }
+
+        template<int... I>
+            void write(const Record& record, int row, detail::IndexSequence<I...>)
+            {
+                detail::Expand{(get<I>(row) = Fields::get(record), 0)...};
+            }
+
+        template<int... I>
+            void append(const Record& record, detail::IndexSequence<I...>)
+            {
+                detail::Expand{(std::get<I>(columns_).push_back(Fields::get(record)), 0)...};
+            }
+
+        template<int... I>
+            void insert(int row, int count, detail::IndexSequence<I...>)
+            {
+                detail::Expand{(std::get<I>(columns_).insert(
+                    std::get<I>(columns_).begin() + row, count,
+                    typename Fields::value_type()), 0)...};
+            }
+
+        template<int... I>
+            void remove(int row, int count, detail::IndexSequence<I...>)
+            {
+                detail::Expand{(std::get<I>(columns_).erase(
+                    std::get<I>(columns_).begin() + row,
+                    std::get<I>(columns_).begin() + row + count), 0)...};
+            }
+
+        template<int... I>
+            void move(int row, int count, int to_row, detail::IndexSequence<I...>)
+            {
+                detail::Expand{(detail::moveRange(std::get<I>(columns_), row, count, to_row), 0)...};
+            }
+
+        template<int... I>
+            void reserve(int count, detail::IndexSequence<I...>)
+            {
+                detail::Expand{(std::get<I>(columns_).reserve(count), 0)...};
+            }
+
+        std::tuple<std::vector<typename Fields::value_type>...> columns_;
+    };
+
+/**
+ * \brief Flat model showing a field of a record in each column
+ *
+ * The columns are fixed at compile time, data() and setData() go through
+ * tables with a function for each column instead of switching on it, and
+ * value() and setValue() access a column with its static type.
+ *
+ * \tparam Storage  RecordStorage or FieldStorage
+ * \tparam Fields   Fields shown as columns, see IMV_FIELD()
+ *
+ * Use the StructTableModel and FieldTableModel aliases.
+ */
+template<class Storage, class... Fields>
+    class BasicStructTableModel : public Model
+    {
+    public:
+        typedef typename Storage::record_type Record;
+
+        static_assert(sizeof...(Fields) > 0, "A struct table model needs at least a field");
+        static_assert(detail::AllOf<std::is_same<typename Fields::record_type, Record>...>::value,
+                      "All the fields must belong to the record type");
+
+        enum { ColumnCount = sizeof...(Fields) };
+
+        /**
+         * \brief Type of the values in \p Column
+         */
+        template<int Column>
+            using ValueType = typename detail::TypeAt<Column, Fields...>::type::value_type;
+
+        Record record(int row) const
+        {
+            return storage_.record(row);
+        }
+
+        /**
+         * \brief Replaces the record at \p row, emitting dataRangeChanged() for the row
+         */
+        void setRecord(int row, const Record& record)
+        {
+            storage_.setRecord(row, record);
+            rangeChanged(row, 0, 1, ColumnCount, Index(), Value);
+        }
+
+        void append(const Record& record)
+        {
+            storage_.append(record);
+            notifyRowsAdded(storage_.size() - 1, 1, Index());
+        }
+
+        /**
+         * \brief Appends several records with a single rowsAdded()
+         */
+        void append(const std::vector<Record>& records)
+        {
+            if ( records.empty() )
+                return;
+            int row = storage_.size();
+            storage_.reserve(row + records.size());
+            for ( const Record& record : records )
+                storage_.append(record);
+            notifyRowsAdded(row, records.size(), Index());
+        }
+
+        template<int Column>
+            const ValueType<Column>& value(int row) const
+            {
+                return storage_.template get<Column>(row);
+            }
+
+        /**
+         * \brief Sets a value without converting it to QVariant, but for dataChanged()
+         */
+        template<int Column>
+            void setValue(int row, const ValueType<Column>& value)
+            {
+                storage_.template get<Column>(row) = value;
+                itemChanged(index(row, Column), QVariant::fromValue(value), Value);
+            }
+
+        /**
+         * \brief Values of \p Column in [row, row + count)
+         */
+        template<int Column>
+            std::vector<ValueType<Column>> values(int row, int count) const
+            {
+                std::vector<ValueType<Column>> values;
+                values.reserve(count);
+                for ( int i = row; i < row + count; i++ )
+                    values.push_back(storage_.template get<Column>(i));
+                return values;
+            }
+
+        const Storage& storage() const
+        {
+            return storage_;
+        }
+
+    protected:
+        int onRowCount(const Index& parent) const override
+        {
+            return parent.valid() ? 0 : storage_.size();
+        }
+
+        int onColumnCount(const Index& parent) const override
+        {
+            return parent.valid() ? 0 : int(ColumnCount);
+        }
+
+        bool onValid(const Index& index) const override
+        {
+            return index.row() < storage_.size() && index.column() < ColumnCount;
+        }
+
+        QVariant onData(const Index& index, int role) const override
+        {
+            if ( role != Value )
+                return QVariant();
+            return readers(Indices())[index.column()](storage_, index.row());
+        }
+
+        QVector<QVariant> onDataRange(int column, int row, int count,
+                                      const Index& parent, int role) const override
+        {
+            if ( role != Value )
+                return QVector<QVariant>(count);
+            return rangeReaders(Indices())[column](storage_, row, count);
+        }
+
+        bool onSetData(const Index& index, const QVariant& value, int role) override
+        {
+            if ( role != Value )
+                return false;
+            return writers(Indices())[index.column()](storage_, index.row(), value);
+        }
+
+        bool onInsertRows(int row, int count, const Index& parent) override
+        {
+            if ( parent.valid() )
+                return false;
+            storage_.insert(row, count);
+            return true;
+        }
+
+        bool onRemoveRows(int row, int count, const Index& parent) override
+        {
+            if ( parent.valid() || row + count > storage_.size() )
+                return false;
+            storage_.remove(row, count);
+            return true;
+        }
+
+        bool onMoveRows(const Index& from_parent, int from_row, int count,
+                        const Index& to_parent, int to_row) override
+        {
+            int rows = storage_.size();
+            if ( from_parent.valid() || to_parent.valid() ||
+                 from_row + count > rows || to_row < 0 || to_row > rows ||
+                 (to_row >= from_row && to_row <= from_row + count) )
+                return false;
+            storage_.move(from_row, count, to_row);
+            return true;
+        }
+
+    private:
+        typedef typename detail::MakeIndexSequence<sizeof...(Fields)>::type Indices;
+        typedef QVariant (*Reader)(const Storage&, int);
+        typedef QVector<QVariant> (*RangeReader)(const Storage&, int, int);
+        typedef bool (*Writer)(Storage&, int, const QVariant&);
+
+        template<int Column>
+            static QVariant read(const Storage& storage, int row)
+            {
+                return QVariant::fromValue(storage.template get<Column>(row));
+            }
+
+        template<int Column>
+            static QVector<QVariant> readRange(const Storage& storage, int row, int count)
+            {
+                QVector<QVariant> values;
+                values.reserve(count);
+                for ( int i = row; i < row + count; i++ )
+                    values.append(QVariant::fromValue(storage.template get<Column>(i)));
+                return values;
+            }
+
+        template<int Column>
+            static bool write(Storage& storage, int row, const QVariant& value)
+            {
+                ValueType<Column> converted = ValueType<Column>();
+                if ( !detail::fromVariant(value, converted) )
+                    return false;
+                storage.template get<Column>(row) = converted;
+                return true;
+            }
+
+        template<int... I>
+            static const Reader* readers(detail::IndexSequence<I...>)
+            {
+                static const Reader table[] = { &read<I>... };
+                return table;
+            }
+
+        template<int... I>
+            static const RangeReader* rangeReaders(detail::IndexSequence<I...>)
+            {
+                static const RangeReader table[] = { &readRange<I>... };
+                return table;
+            }
+
+        template<int... I>
+            static const Writer* writers(detail::IndexSequence<I...>)
+            {
+                static const Writer table[] = { &write<I>... };
+                return table;
+            }
+
+        Storage storage_;
+    };
+
+/**
+ * \brief Model of records stored in a contiguous vector
+ *
+ * \code
+ * struct Point { int x; double y; };
+ * StructTableModel<Point, IMV_FIELD(Point, x), IMV_FIELD(Point, y)> model;
+ * \endcode
+ */
+template<class Record, class... Fields>
+    using StructTableModel = BasicStructTableModel<RecordStorage<Record, Fields...>, Fields...>;
+
+/**
+ * \brief Model of records stored with a vector for each field
+ */
+template<class Record, class... Fields>
+    using FieldTableModel = BasicStructTableModel<FieldStorage<Record, Fields...>, Fields...>;
+
+} // namespace imv
+#endif // IMV_STRUCT_TABLE_MODEL_HPP
@@ -0,0 +1,237 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_TABLE_MODEL_HPP
+#define IMV_TABLE_MODEL_HPP
+
+#include <memory>
+#include <vector>
+#include "model.hpp"
+#include "column.hpp"
+#include "cell_pool.hpp"
+
+namespace imv {
+
+/**
+ * \brief Flat model storing its data column by column
+ *
+ * Each column is an instance of a Column subclass, so different
+ * columns can use the storage that best fits their values.
+ *
+ * The model owns a CellPool columns can allocate their storage from,
+ * eg: \code addColumn<VariantColumn>(&cellPool()) \endcode
+ */
+class TableModel : public Model
+{
+public:
+    /**
+     * \brief Appends a column, taking ownership of it
+     * \returns The index of the new column
+     *
+     * The column is resized to match the number of rows in the model.
+     * Emits columnsAdded().
+     */
+    int addColumn(std::unique_ptr<Column> column)
+    {
+        if ( column->size() > rows_ )
+            column->removeRows(rows_, column->size() - rows_);
+        else if ( column->size() < rows_ )
+            column->insertRows(column->size(), rows_ - column->size());
+
+        int index = columns_.size();
+        columns_.push_back(std::move(column));
+        notifyColumnsAdded(index, 1, Index());
+        return index;
+    }
+
+    /**
+     * \brief Appends a column of type \p ColumnT
+     * \returns A pointer to the new column, owned by the model
+     */
+    template<class ColumnT, class... Args>
+        ColumnT* addColumn(Args&&... args)
+        {
+            ColumnT* column = new ColumnT(std::forward<Args>(args)...);
+            addColumn(std::unique_ptr<Column>(column));
+            return column;
+        }
+
+    /**
+     * \brief Storage for the given column
+     * \returns \b nullptr if \p index is out of range
+     */
+    Column* column(int index) const
+    {
+        if ( index < 0 || index >= int(columns_.size()) )
+            return nullptr;
+        return columns_[index].get();
+    }
+
+    /**
+     * \brief Storage for the given column, cast to \p ColumnT
+     * \returns \b nullptr if \p index is out of range or not a \p ColumnT
+     */
+    template<class ColumnT>
+        ColumnT* column(int index) const
+        {
+            return dynamic_cast<ColumnT*>(column(index));
+        }
+
+    /**
+     * \brief Removes all the rows, releasing the pool arenas at once
+     *
+     * Emits modelAboutToReset() and modelReset().
+     */
+    void clear()
+    {
+        beginReset();
+        for ( const auto& column : columns_ )
+            column->clear();
+        rows_ = 0;
+        pool_.release();
+        endReset();
+    }
+
+    /**
+     * \brief Pool shared by the columns of this model
+     *
+     * Its arenas are released by clear(), once all the rows have been
+     * removed or once the columns using it have been removed.
+     */
+    CellPool& cellPool()
+    {
+        return pool_;
+    }
+
+    /**
+     * \brief Allocation statistics of cellPool()
+     */
+    const PoolStats& allocationStats() const
+    {
+        return pool_.stats();
+    }
+
+protected:
+    int onRowCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : rows_;
+    }
+
+    int onColumnCount(const Index& parent) const override
+    {
+        return parent.valid() ? 0 : columns_.size();
+    }
+
+    bool onValid(const Index& index) const override
+    {
+        return index.row() < rows_ && index.column() < int(columns_.size());
+    }
+
+    QVariant onData(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return QVariant();
+        return columns_[index.column()]->data(index.row());
+    }
+
+    bool onIsNull(const Index& index, int role) const override
+    {
+        if ( role != Value )
+            return true;
+        return columns_[index.column()]->isNull(index.row());
+    }
+
+    Bitmap onNullMask(int column, int row, int count, const Index& parent) const override
+    {
+        return columns_[column]->nullMask(row, count);
+    }
+
+    bool onSetData(const Index& index, const QVariant& value, int role) override
+    {
+        if ( role != Value )
+            return false;
+        return columns_[index.column()]->setData(index.row(), value);
+    }
+
+    bool onInsertRows(int row, int count, const Index& parent) override
+    {
+        if ( parent.valid() )
+            return false;
+        for ( const auto& column : columns_ )
+            column->insertRows(row, count);
+        rows_ += count;
+        return true;
+    }
+
+    bool onRemoveRows(int row, int count, const Index& parent) override
+    {
+        if ( parent.valid() || row + count > rows_ )
+            return false;
+        for ( const auto& column : columns_ )
+            column->removeRows(row, count);
+        rows_ -= count;
+        if ( rows_ == 0 )
+            pool_.trim();
+        return true;
+    }
+
+    bool onMoveRows(const Index& from_parent, int from_row, int count,
+                    const Index& to_parent, int to_row) override
+    {
+        if ( from_parent.valid() || to_parent.valid() ||
+             from_row + count > rows_ || to_row < 0 || to_row > rows_ ||
+             (to_row >= from_row && to_row <= from_row + count) )
+            return false;
+        for ( const auto& column : columns_ )
+            column->moveRows(from_row, count, to_row);
+        return true;
+    }
+
+    bool onRemoveColumns(int column, int count, const Index& parent) override
+    {
+        if ( parent.valid() || column + count > int(columns_.size()) )
+            return false;
+        columns_.erase(columns_.begin() + column,
+                       columns_.begin() + column + count);
+        pool_.trim();
+        return true;
+    }
+
+    bool onMoveColumns(const Index& from_parent, int from_column, int count,
+                       const Index& to_parent, int to_column) override
+    {
+        if ( from_parent.valid() || to_parent.valid() ||
+             from_column + count > int(columns_.size()) ||
+             to_column < 0 || to_column > int(columns_.size()) ||
+             (to_column >= from_column && to_column <= from_column + count) )
+            return false;
+        detail::moveRange(columns_, from_column, count, to_column);
+        return true;
+    }
+
+private:
+    /// Declared before columns_ so it outlives them
+    CellPool pool_;
+    std::vector<std::unique_ptr<Column>> columns_;
+    int rows_ = 0;
+};
+
+} // namespace imv
+#endif // IMV_TABLE_MODEL_HPP
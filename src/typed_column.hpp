@@ -0,0 +1,263 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_TYPED_COLUMN_HPP
+#define IMV_TYPED_COLUMN_HPP
+
+#include "column.hpp"
+#include "bitmap.hpp"
+#include "zone_map.hpp"
+#include "filter_kernels.hpp"
+
+namespace imv {
+
+/**
+ * \brief Column storing values of type \p T contiguously
+ *
+ * Null values are tracked in a separate bitmap and a ZoneMap is kept
+ * so range queries can skip whole blocks of rows.
+ */
+template<class T>
+class TypedColumn : public Column
+{
+public:
+    typedef T value_type;
+    typedef typename ZoneMap<T>::Zone Zone;
+
+    /**
+     * \param zone_size Number of rows summarized by each zone
+     */
+    explicit TypedColumn(int zone_size = 1024)
+        : zones_(zone_size)
+    {}
+
+    /**
+     * \brief All the values, null rows hold a default-constructed value
+     */
+    const std::vector<T>& values() const
+    {
+        return values_;
+    }
+
+    /**
+     * \brief Bitmap with bits set for rows which aren't null
+     */
+    const Bitmap& validity() const
+    {
+        return valid_;
+    }
+
+    /**
+     * \brief Value at the given row
+     */
+    const T& value(int row) const
+    {
+        return values_[row];
+    }
+
+    /**
+     * \brief Sets the value at the given row
+     */
+    void setValue(int row, const T& value)
+    {
+        zones_.update(row, values_[row], valid_.test(row), value, true);
+        values_[row] = value;
+        valid_.set(row);
+    }
+
+    /**
+     * \brief Makes the given row null
+     */
+    void setNull(int row)
+    {
+        zones_.update(row, values_[row], valid_.test(row), T(), false);
+        values_[row] = T();
+        valid_.set(row, false);
+    }
+
+    /**
+     * \brief Number of zones
+     */
+    int zoneCount() const
+    {
+        return zones_.blockCount();
+    }
+
+    /**
+     * \brief Number of rows summarized by each zone
+     */
+    int zoneSize() const
+    {
+        return zones_.blockSize();
+    }
+
+    /**
+     * \brief Summary for the rows in the given zone
+     */
+    const Zone& zone(int index) const
+    {
+        return zones_.zone(index, values_, valid_);
+    }
+
+    /**
+     * \brief Rows with values between \p low and \p high (inclusive)
+     */
+    std::vector<int> findRange(const T& low, const T& high) const
+    {
+        std::vector<int> rows;
+        for ( int i = 0; i < zoneCount(); i++ )
+        {
+            const Zone& summary = zone(i);
+            if ( !summary.overlaps(low, high) )
+                continue;
+
+            int begin = i * zoneSize();
+            int end = begin + summary.size;
+            if ( summary.within(low, high) )
+            {
+                for ( int row = begin; row < end; row++ )
+                    rows.push_back(row);
+                continue;
+            }
+
+            for ( int row = begin; row < end; row++ )
+                if ( valid_.test(row) && !(values_[row] < low) && !(high < values_[row]) )
+                    rows.push_back(row);
+        }
+        return rows;
+    }
+
+    /**
+     * \brief Selects the non-null rows for which <tt>value op operand</tt> holds
+     */
+    Bitmap select(CompareOp op, const T& operand) const
+    {
+        Bitmap result = kernels::compare(values_.data(), size(), op, operand);
+        result &= valid_;
+        return result;
+    }
+
+    /**
+     * \brief Selects the rows with values between \p low and \p high (inclusive)
+     */
+    Bitmap selectRange(const T& low, const T& high) const
+    {
+        Bitmap result = kernels::between(values_.data(), size(), low, high);
+        result &= valid_;
+        return result;
+    }
+
+    /**
+     * \brief Selects the rows with values equal to any element of \p set
+     */
+    Bitmap selectIn(const std::vector<T>& set) const
+    {
+        Bitmap result = kernels::inSet(values_.data(), size(), set);
+        result &= valid_;
+        return result;
+    }
+
+    /**
+     * \brief Selects the null rows
+     */
+    Bitmap selectNull() const
+    {
+        return kernels::isNull(valid_);
+    }
+
+    /**
+     * \brief Number of null rows
+     */
+    int nullCount() const
+    {
+        int count = 0;
+        for ( int i = 0; i < zoneCount(); i++ )
+            count += zone(i).null_count;
+        return count;
+    }
+
+    int size() const override
+    {
+        return values_.size();
+    }
+
+    QVariant data(int row) const override
+    {
+        if ( !valid_.test(row) )
+            return QVariant();
+        return QVariant::fromValue(values_[row]);
+    }
+
+    bool setData(int row, const QVariant& value) override
+    {
+        if ( !value.isValid() )
+        {
+            setNull(row);
+            return true;
+        }
+
+        T converted = T();
+        if ( !detail::fromVariant(value, converted) )
+            return false;
+        setValue(row, converted);
+        return true;
+    }
+
+    bool isNull(int row) const override
+    {
+        return !valid_.test(row);
+    }
+
+    Bitmap nullMask(int row, int count) const override
+    {
+        Bitmap mask = valid_.slice(row, count);
+        mask.flip();
+        return mask;
+    }
+
+    void insertRows(int row, int count) override
+    {
+        values_.insert(values_.begin() + row, count, T());
+        valid_.insert(row, count, false);
+        zones_.invalidate(row, values_.size());
+    }
+
+    void removeRows(int row, int count) override
+    {
+        values_.erase(values_.begin() + row, values_.begin() + row + count);
+        valid_.remove(row, count);
+        zones_.invalidate(row, values_.size());
+    }
+
+    void moveRows(int row, int count, int to_row) override
+    {
+        detail::moveRange(values_, row, count, to_row);
+        valid_.move(row, count, to_row);
+        zones_.invalidate(std::min(row, to_row), values_.size());
+    }
+
+private:
+    std::vector<T> values_;
+    Bitmap valid_;
+    ZoneMap<T> zones_;
+};
+
+} // namespace imv
+#endif // IMV_TYPED_COLUMN_HPP
@@ -0,0 +1,308 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_UNDO_COMMANDS_HPP
+#define IMV_UNDO_COMMANDS_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <QUndoCommand>
+#include "model.hpp"
+
+namespace imv {
+
+namespace detail {
+
+/**
+ * \brief Position of an index as a chain of rows and columns from the root
+ *
+ * Unlike Index, this stays meaningful while the model is being changed
+ * by the other commands on the stack.
+ */
+class IndexPath
+{
+public:
+    IndexPath(const Index& index = {})
+    {
+        for ( Index item = index; item.valid(); item = item.parent() )
+            steps_.emplace_back(item.row(), item.column());
+        std::reverse(steps_.begin(), steps_.end());
+    }
+
+    /**
+     * \brief Finds the index in \p model, the root if the path is empty
+     */
+    Index resolve(const Model* model) const
+    {
+        Index index;
+        for ( const auto& step : steps_ )
+            index = model->index(step.first, step.second, index);
+        return index;
+    }
+
+    bool operator==(const IndexPath& other) const
+    {
+        return steps_ == other.steps_;
+    }
+
+    bool operator!=(const IndexPath& other) const
+    {
+        return steps_ != other.steps_;
+    }
+
+private:
+    std::vector<std::pair<int, int>> steps_;
+};
+
+/**
+ * \brief Keeps a data batch open for the lifetime of the object
+ */
+class DataBatchGuard
+{
+public:
+    explicit DataBatchGuard(Model* model)
+        : model_(model)
+    {
+        model_->beginDataBatch();
+    }
+
+    ~DataBatchGuard()
+    {
+        model_->endDataBatch();
+    }
+
+private:
+    Model* model_;
+};
+
+} // namespace detail
+
+/**
+ * \brief Undoable change to the data of one or more items
+ *
+ * Only the changed items are stored, with their values before and after
+ * the change. Undo and redo are applied as a single data batch so the
+ * model emits one dataRangeChanged() instead of a signal per item.
+ *
+ * Commands with the same non-negative \p merge_id on the same model and
+ * parent are merged by QUndoStack, so many small edits (eg: a paste)
+ * become a single undo step.
+ */
+class SetDataCommand : public QUndoCommand
+{
+public:
+    explicit SetDataCommand(Model* model, const Index& parent = {},
+                            int merge_id = -1, QUndoCommand* parent_command = nullptr)
+        : QUndoCommand(parent_command),
+          model_(model),
+          parent_(parent),
+          merge_id_(merge_id)
+    {
+        setText(QObject::tr("Edit"));
+    }
+
+    /**
+     * \brief Records a change for the item at \p row, \p column
+     *
+     * The value before the change is read from the model,
+     * the change itself is applied by redo().
+     */
+    void add(int row, int column, const QVariant& value, int role = Value)
+    {
+        Index index = model_->index(row, column, parent_.resolve(model_));
+        changes_.push_back(Change{row, column, role, model_->data(index, role), value});
+    }
+
+    /**
+     * \brief Number of recorded changes
+     */
+    int count() const
+    {
+        return changes_.size();
+    }
+
+    void redo() override
+    {
+        apply(changes_.begin(), changes_.end(), &Change::after);
+    }
+
+    void undo() override
+    {
+        apply(changes_.rbegin(), changes_.rend(), &Change::before);
+    }
+
+    int id() const override
+    {
+        return merge_id_;
+    }
+
+    bool mergeWith(const QUndoCommand* other) override
+    {
+        auto command = dynamic_cast<const SetDataCommand*>(other);
+        if ( !command || command->model_ != model_ || command->parent_ != parent_ )
+            return false;
+        changes_.insert(changes_.end(), command->changes_.begin(), command->changes_.end());
+        return true;
+    }
+
+private:
+    struct Change
+    {
+        int row;
+        int column;
+        int role;
+        QVariant before;
+        QVariant after;
+    };
+
+    template<class Iterator>
+        void apply(Iterator begin, Iterator end, QVariant Change::* value)
+        {
+            detail::DataBatchGuard batch(model_);
+            Index parent = parent_.resolve(model_);
+            for ( ; begin != end; ++begin )
+                model_->setData(model_->index(begin->row, begin->column, parent),
+                                (*begin).*value, begin->role);
+        }
+
+    Model* model_;
+    detail::IndexPath parent_;
+    int merge_id_;
+    std::vector<Change> changes_;
+};
+
+/**
+ * \brief Undoable removal of rows
+ *
+ * Only the items with a value are stored to restore the rows on undo,
+ * null items are skipped using Model::nullMask().
+ */
+class RemoveRowsCommand : public QUndoCommand
+{
+public:
+    RemoveRowsCommand(Model* model, int row, int count, const Index& parent = {},
+                      QUndoCommand* parent_command = nullptr)
+        : QUndoCommand(parent_command),
+          model_(model),
+          parent_(parent),
+          row_(row),
+          count_(count)
+    {
+        setText(QObject::tr("Remove Rows"));
+
+        int columns = model_->columnCount(parent);
+        for ( int column = 0; column < columns; column++ )
+        {
+            Bitmap nulls = model_->nullMask(column, row, count, parent);
+            for ( int i = 0; i < nulls.size(); i++ )
+            {
+                if ( !nulls[i] )
+                {
+                    Index index = model_->index(row + i, column, parent);
+                    cells_.push_back(Cell{i, column, model_->data(index)});
+                }
+            }
+        }
+    }
+
+    void redo() override
+    {
+        model_->removeRows(row_, count_, parent_.resolve(model_));
+    }
+
+    void undo() override
+    {
+        Index parent = parent_.resolve(model_);
+        if ( !model_->insertRows(row_, count_, parent) )
+            return;
+
+        detail::DataBatchGuard batch(model_);
+        for ( const auto& cell : cells_ )
+            model_->setData(model_->index(row_ + cell.row, cell.column, parent), cell.value);
+    }
+
+private:
+    struct Cell
+    {
+        int row;    ///< Relative to row_
+        int column;
+        QVariant value;
+    };
+
+    Model* model_;
+    detail::IndexPath parent_;
+    int row_;
+    int count_;
+    std::vector<Cell> cells_;
+};
+
+/**
+ * \brief Undoable move of rows
+ *
+ * Undo moves the rows back, so nothing but the positions is stored.
+ */
+class MoveRowsCommand : public QUndoCommand
+{
+public:
+    MoveRowsCommand(Model* model, const Index& from_parent, int from_row, int count,
+                    const Index& to_parent, int to_row,
+                    QUndoCommand* parent_command = nullptr)
+        : QUndoCommand(parent_command),
+          model_(model),
+          from_parent_(from_parent),
+          to_parent_(to_parent),
+          from_row_(from_row),
+          count_(count),
+          to_row_(to_row)
+    {
+        setText(QObject::tr("Move Rows"));
+    }
+
+    void redo() override
+    {
+        model_->moveRows(from_parent_.resolve(model_), from_row_, count_,
+                         to_parent_.resolve(model_), to_row_);
+    }
+
+    void undo() override
+    {
+        Index from_parent = from_parent_.resolve(model_);
+        Index to_parent = to_parent_.resolve(model_);
+
+        if ( from_parent_ != to_parent_ )
+            model_->moveRows(to_parent, to_row_, count_, from_parent, from_row_);
+        else if ( to_row_ > from_row_ )
+            model_->moveRows(to_parent, to_row_ - count_, count_, from_parent, from_row_);
+        else
+            model_->moveRows(to_parent, to_row_, count_, from_parent, from_row_ + count_);
+    }
+
+private:
+    Model* model_;
+    detail::IndexPath from_parent_;
+    detail::IndexPath to_parent_;
+    int from_row_;
+    int count_;
+    int to_row_;
+};
+
+} // namespace imv
+#endif // IMV_UNDO_COMMANDS_HPP
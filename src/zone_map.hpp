@@ -0,0 +1,185 @@
+/**
+ * \file
+ *
+ * \author Mattia Basaglia
+ *
+ * \copyright Copyright (C) 2015 Mattia Basaglia
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMV_ZONE_MAP_HPP
+#define IMV_ZONE_MAP_HPP
+
+#include <algorithm>
+#include <vector>
+#include "bitmap.hpp"
+
+namespace imv {
+
+/**
+ * \brief Minimum, maximum and null count for fixed-size blocks of a column
+ *
+ * Zones are recomputed lazily: changes only mark the affected zones as
+ * stale and zone() refreshes them from the column data when needed.
+ */
+template<class T>
+class ZoneMap
+{
+public:
+    struct Zone
+    {
+        T   min = T();
+        T   max = T();
+        int size = 0;
+        int null_count = 0;
+        bool stale = true;
+
+        /**
+         * \brief Whether all the values in the block are null
+         */
+        bool empty() const
+        {
+            return null_count == size;
+        }
+
+        /**
+         * \brief Whether some value in the block may be between \p low and \p high
+         */
+        bool overlaps(const T& low, const T& high) const
+        {
+            return !empty() && !(max < low) && !(high < min);
+        }
+
+        /**
+         * \brief Whether all the values in the block are between \p low and \p high
+         */
+        bool within(const T& low, const T& high) const
+        {
+            return null_count == 0 && !(min < low) && !(high < max);
+        }
+    };
+
+    explicit ZoneMap(int block_size = 1024)
+        : block_size_(std::max(block_size, 1))
+    {}
+
+    int blockSize() const
+    {
+        return block_size_;
+    }
+
+    int blockCount() const
+    {
+        return zones_.size();
+    }
+
+    /**
+     * \brief Zone for the given block, refreshed if it was stale
+     * \param values    Values of the column
+     * \param valid     Which values are not null
+     */
+    const Zone& zone(int block, const std::vector<T>& values, const Bitmap& valid) const
+    {
+        Zone& zone = zones_[block];
+        if ( zone.stale )
+        {
+            int begin = block * block_size_;
+            int end = std::min<int>(begin + block_size_, values.size());
+            zone.size = end - begin;
+            zone.null_count = 0;
+            bool first = true;
+            for ( int i = begin; i < end; i++ )
+            {
+                if ( !valid.test(i) )
+                {
+                    zone.null_count++;
+                }
+                else if ( first )
+                {
+                    zone.min = zone.max = values[i];
+                    first = false;
+                }
+                else if ( values[i] < zone.min )
+                {
+                    zone.min = values[i];
+                }
+                else if ( zone.max < values[i] )
+                {
+                    zone.max = values[i];
+                }
+            }
+            zone.stale = false;
+        }
+        return zone;
+    }
+
+    /**
+     * \brief Updates the zone of \p row after its value has been changed
+     */
+    void update(int row, const T& old_value, bool old_valid,
+                const T& value, bool valid)
+    {
+        Zone& zone = zones_[row / block_size_];
+        if ( zone.stale )
+            return;
+
+        if ( old_valid )
+        {
+            // Removing a boundary value can shrink the range
+            if ( !(zone.min < old_value) || !(old_value < zone.max) )
+            {
+                zone.stale = true;
+                return;
+            }
+        }
+        else
+        {
+            zone.null_count--;
+        }
+
+        if ( !valid )
+        {
+            zone.null_count++;
+        }
+        else if ( !old_valid && zone.null_count == zone.size - 1 )
+        {
+            zone.min = zone.max = value;
+        }
+        else
+        {
+            if ( value < zone.min )
+                zone.min = value;
+            if ( zone.max < value )
+                zone.max = value;
+        }
+    }
+
+    /**
+     * \brief Marks as stale all the zones containing \p row or following rows
+     * \param size  Number of rows in the column after the change
+     */
+    void invalidate(int row, int size)
+    {
+        zones_.resize((size + block_size_ - 1) / block_size_);
+        for ( int i = row / block_size_; i < int(zones_.size()); i++ )
+            zones_[i].stale = true;
+    }
+
+private:
+    int block_size_;
+    mutable std::vector<Zone> zones_;
+};
+
+} // namespace imv
+#endif // IMV_ZONE_MAP_HPP